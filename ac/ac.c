@@ -7,6 +7,8 @@
 #include "ac.h"
 #include "bits.h"
 #include "mcu.h"
+#include "cpu.h"
+#include "irq.h"
 
 
 /* There is no limit.  */
@@ -15,10 +17,38 @@
 #endif
 
 
+#ifndef AC_IRQ_PRIORITY
+#define AC_IRQ_PRIORITY 4
+#endif
+
+
+/* Number of timestamped edges that can be queued.  */
+#ifndef AC_EVENTS_NUM
+#define AC_EVENTS_NUM 16
+#endif
+
+
+/* The period estimate is smoothed with a first order IIR filter with
+   a time constant of 2^AC_ZC_SMOOTH_SHIFT cycles.  */
+#ifndef AC_ZC_SMOOTH_SHIFT
+#define AC_ZC_SMOOTH_SHIFT 3
+#endif
+
+
+/* The period is stored scaled by 16 so that the smoothing does not
+   lose resolution.  This allows periods up to 2^28 CPU clocks.  */
+#define AC_ZC_SCALE_SHIFT 4
+
+
 static uint8_t ac_devices_num = 0;
 static ac_dev_t ac_devices[AC_DEVICES_NUM];
 static ac_dev_t *ac_config_last = 0;
 
+static ac_event_t ac_events[AC_EVENTS_NUM];
+static volatile uint8_t ac_events_in = 0;
+static volatile uint8_t ac_events_out = 0;
+static uint32_t ac_overruns = 0;
+
 
 /* Resets AC.  */
 static void
@@ -132,6 +162,151 @@ ac_poll (ac_t ac)
 
 
 
+static void
+ac_isr (void)
+{
+    uint32_t timestamp;
+    uint32_t status;
+    uint8_t in;
+    uint8_t next;
+
+    /* Sample the time first to minimise jitter.  */
+    timestamp = cpu_cycle_counter_get ();
+
+    /* This clears the comparison edge flag.  */
+    status = ACC->ACC_ISR;
+    if (!(status & ACC_ISR_CE))
+        return;
+
+    in = ac_events_in;
+    next = (in + 1) % AC_EVENTS_NUM;
+    if (next == ac_events_out)
+    {
+        ac_overruns++;
+        return;
+    }
+
+    ac_events[in].timestamp = timestamp;
+    ac_events[in].rising = (status & ACC_ISR_SCO) != 0;
+    ac_events_in = next;
+}
+
+
+void
+ac_capture_start (ac_t ac)
+{
+    ac_config (ac);
+
+    ac_events_in = 0;
+    ac_events_out = 0;
+    ac_overruns = 0;
+
+    irq_config (ID_ACC, AC_IRQ_PRIORITY, ac_isr);
+
+    /* Clear stale edge.  */
+    ACC->ACC_ISR;
+    ACC->ACC_IER = ACC_IER_CE;
+
+    irq_enable (ID_ACC);
+}
+
+
+void
+ac_capture_stop (ac_t ac)
+{
+    ACC->ACC_IDR = ACC_IER_CE;
+    irq_disable (ID_ACC);
+}
+
+
+bool
+ac_capture_read (ac_t ac, ac_event_t *event)
+{
+    uint8_t out;
+
+    out = ac_events_out;
+    if (out == ac_events_in)
+        return 0;
+
+    *event = ac_events[out];
+    ac_events_out = (out + 1) % AC_EVENTS_NUM;
+    return 1;
+}
+
+
+uint32_t
+ac_capture_overruns_get (ac_t ac)
+{
+    return ac_overruns;
+}
+
+
+void
+ac_zc_init (ac_zc_t *zc)
+{
+    zc->last = 0;
+    zc->period = 0;
+    zc->count = 0;
+}
+
+
+bool
+ac_zc_update (ac_zc_t *zc, const ac_event_t *event)
+{
+    uint32_t period;
+
+    if (!event->rising)
+        return zc->count > 1;
+
+    if (zc->count)
+    {
+        /* This handles the cycle counter wrapping.  */
+        period = (event->timestamp - zc->last) << AC_ZC_SCALE_SHIFT;
+
+        if (zc->count == 1)
+            zc->period = period;
+        else
+            zc->period += (int32_t)(period - zc->period) >> AC_ZC_SMOOTH_SHIFT;
+    }
+
+    zc->last = event->timestamp;
+    zc->count++;
+
+    return zc->count > 1;
+}
+
+
+uint32_t
+ac_zc_period_get (ac_zc_t *zc)
+{
+    return (zc->period + BIT (AC_ZC_SCALE_SHIFT - 1)) >> AC_ZC_SCALE_SHIFT;
+}
+
+
+uint32_t
+ac_zc_frequency_get (ac_zc_t *zc)
+{
+    if (!zc->period)
+        return 0;
+
+    return (((uint64_t)F_CPU * 1000) << AC_ZC_SCALE_SHIFT) / zc->period;
+}
+
+
+uint16_t
+ac_zc_phase_get (ac_zc_t *zc, uint32_t timestamp)
+{
+    uint32_t period;
+
+    period = ac_zc_period_get (zc);
+    if (!period)
+        return 0;
+
+    /* If a crossing has been missed, the phase wraps.  */
+    return (((uint64_t)(timestamp - zc->last)) << 16) / period;
+}
+
+
 /** Initalises the AC registers for polling operation.  */
 ac_t
 ac_init (const ac_cfg_t *cfg)
@@ -141,14 +316,12 @@ ac_init (const ac_cfg_t *cfg)
     if (ac_devices_num >= AC_DEVICES_NUM)
         return 0;
 
+    /* The clock only needs to be enabled when sampling.  The clock is
+       automatically started for the SAM7.  */
+    mcu_pmc_acquire (ID_ACC);
+
     if (ac_devices_num == 0)
-    {
-        /* The clock only needs to be enabled when sampling.  The clock is
-           automatically started for the SAM7.  */
-        mcu_pmc_enable (ID_ACC);
-        
         ac_reset ();
-    }
 
     ac = ac_devices + ac_devices_num;
     ac_devices_num++;
@@ -165,6 +338,5 @@ ac_init (const ac_cfg_t *cfg)
 void
 ac_shutdown (ac_t ac)
 {
-    /* TODO.  */
-    mcu_pmc_disable (ID_ACC);
+    mcu_pmc_release (ID_ACC);
 }
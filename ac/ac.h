@@ -68,6 +68,28 @@ typedef struct ac_dev_struct
 typedef ac_dev_t *ac_t;
 
 
+/** Timestamped comparator edge.  */
+typedef struct ac_event_struct
+{
+    /* Cycle counter value sampled in the interrupt handler.  */
+    uint32_t timestamp;
+    /* Comparator output after the edge.  */
+    bool rising;
+} ac_event_t;
+
+
+/** Zero-crossing estimator state.  */
+typedef struct ac_zc_struct
+{
+    /* Timestamp of last rising crossing.  */
+    uint32_t last;
+    /* Smoothed period in CPU clocks scaled by 16.  */
+    uint32_t period;
+    /* Number of rising crossings seen.  */
+    uint32_t count;
+} ac_zc_t;
+
+
 typedef struct ac_cfg_struct
 {
     ac_channel_t channel;
@@ -119,6 +141,54 @@ bool
 ac_poll (ac_t ac);
 
 
+/** Start timestamping comparator edges in the interrupt handler.
+    The edges are selected by the configured edge type.  Note, ac_poll
+    must not be used while capturing.  */
+void
+ac_capture_start (ac_t ac);
+
+
+void
+ac_capture_stop (ac_t ac);
+
+
+/** Read next timestamped edge.  Return false if none available.  */
+bool
+ac_capture_read (ac_t ac, ac_event_t *event);
+
+
+/** Return number of edges lost due to the queue being full.  */
+uint32_t
+ac_capture_overruns_get (ac_t ac);
+
+
+/** Reset zero-crossing estimator.  */
+void
+ac_zc_init (ac_zc_t *zc);
+
+
+/** Update zero-crossing estimator with an edge.  Only the rising
+    edges are used.  Return true if the period estimate is valid.  */
+bool
+ac_zc_update (ac_zc_t *zc, const ac_event_t *event);
+
+
+/** Return estimated period in CPU clocks.  */
+uint32_t
+ac_zc_period_get (ac_zc_t *zc);
+
+
+/** Return estimated frequency in mHz.  */
+uint32_t
+ac_zc_frequency_get (ac_zc_t *zc);
+
+
+/** Return phase of timestamp relative to the last rising crossing
+    where 65536 corresponds to a full cycle.  */
+uint16_t
+ac_zc_phase_get (ac_zc_t *zc, uint32_t timestamp);
+
+
 ac_t 
 ac_init (const ac_cfg_t *cfg);
 
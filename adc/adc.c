@@ -106,8 +106,10 @@ adc_sleep (adc_t adc)
     /*  Errata for SAM7S256:RevisionB states that the ADC will not be
         placed into sleep mode until a conversion has completed.  */
     adc = adc_init (0);
+    mcu_pmc_acquire (ID_ADC);
     ADC->ADC_MR |= ADC_MR_SLEEP;
     adc_read (adc, &dummy, sizeof (dummy));
+    mcu_pmc_release (ID_ADC);
 }
 
 
@@ -333,11 +335,15 @@ adc_calibration_finished_p (adc_t adc)
 void
 adc_calibrate (adc_t adc)
 {
+    mcu_pmc_acquire (ID_ADC);
     adc_calibration_start (adc);
 
     // This takes 306 ADC clocks.
     while (! adc_calibration_finished_p (adc))
         continue;
+    mcu_pmc_release (ID_ADC);
+
+    BOOT_PROFILE_MARK ("adc_calibrate");
 }
 
 
@@ -345,19 +351,22 @@ adc_calibrate (adc_t adc)
 bool
 adc_config (adc_t adc)
 {
+    mcu_pmc_acquire (ID_ADC);
     adc_channels_select (adc);
 
-    if (! adc_config_dirty)
-        return 1;
-    adc_config_dirty = 0;
+    if (adc_config_dirty)
+    {
+        adc_config_dirty = 0;
 
-    /* Set mode register.  */
-    ADC->ADC_MR = adc->MR;
+        /* Set mode register.  */
+        ADC->ADC_MR = adc->MR;
 
-    /* Set extended mode register.  */
-    ADC->ADC_EMR = adc->EMR;
+        /* Set extended mode register.  */
+        ADC->ADC_EMR = adc->EMR;
 
-    ADC->ADC_CWR = adc->CWR;
+        ADC->ADC_CWR = adc->CWR;
+    }
+    mcu_pmc_release (ID_ADC);
     return 1;
 }
 
@@ -372,14 +381,20 @@ adc_pdc_get (adc_t adc)
 void
 adc_enable (adc_t adc)
 {
-    /* Dummy function for symmetry with ssc driver.  */
+    if (adc->enabled)
+        return;
+    adc->enabled = 1;
+    mcu_pmc_acquire (ID_ADC);
 }
 
 
 void
 adc_disable (adc_t adc)
 {
-    /* Dummy function for symmetry with ssc driver.  */
+    if (! adc->enabled)
+        return;
+    adc->enabled = 0;
+    mcu_pmc_release (ID_ADC);
 }
 
 
@@ -399,14 +414,12 @@ adc_init (const adc_cfg_t *cfg)
     if (adc_devices_num >= ADC_DEVICES_NUM)
         return 0;
 
-    if (adc_devices_num == 0)
-    {
-        /* The clock only needs to be enabled when sampling.  The clock is
-           automatically started for the SAM7.  */
-        mcu_pmc_enable (ID_ADC);
+    /* The clock only needs to be enabled when sampling.  The clock is
+       automatically started for the SAM7.  */
+    mcu_pmc_acquire (ID_ADC);
 
+    if (adc_devices_num == 0)
         adc_reset ();
-    }
 
     adc = adc_devices + adc_devices_num;
     adc_devices_num++;
@@ -414,6 +427,7 @@ adc_init (const adc_cfg_t *cfg)
     adc->MR = 0;
     adc->EMR = 0;
     adc->CWR = 0;
+    adc->enabled = 0;
 
     /* The transfer field must have a value of 2.  */
     BITS_INSERT (adc->MR, 2, 28, 29);
@@ -426,6 +440,8 @@ adc_init (const adc_cfg_t *cfg)
     /* Note, the ADC is not configured until adc_config called.  */
     adc_config (adc);
 
+    mcu_pmc_release (ID_ADC);
+
 #if 0
     /* I'm not sure why a dummy read is required; it is probably a
        quirk of the SAM7.  This will require a software trigger... */
@@ -453,11 +469,17 @@ adc_read (adc_t adc, void *buffer, size_t size)
     uint16_t samples;
     adc_sample_t *data;
 
+    mcu_pmc_acquire (ID_ADC);
     adc_config (adc);
 
     samples = size / sizeof (adc_sample_t);
     data = buffer;
 
+#if MCU_IDLE_WAIT
+    /* This wakes the core when data is ready.  */
+    ADC->ADC_IER = ADC_IER_DRDY;
+#endif
+
     if (adc->trigger == ADC_TRIGGER_SW)
     {
         for (i = 0; i < samples; i++)
@@ -467,8 +489,7 @@ adc_read (adc_t adc, void *buffer, size_t size)
                FIXME */
             adc_conversion_start (adc);
 
-            while (!adc_ready_p (adc))
-                continue;
+            MCU_WAIT_UNTIL (adc_ready_p (adc), ID_ADC);
 
             data[i] = ADC->ADC_LCDR;
         }
@@ -478,15 +499,19 @@ adc_read (adc_t adc, void *buffer, size_t size)
         for (i = 0; i < samples; i++)
         {
             /* Should have timeout, especially for external trigger.  */
-            while (!adc_ready_p (adc))
-                continue;
+            MCU_WAIT_UNTIL (adc_ready_p (adc), ID_ADC);
 
             data[i] = ADC->ADC_LCDR;
         }
     }
 
+#if MCU_IDLE_WAIT
+    ADC->ADC_IDR = ADC_IDR_DRDY;
+#endif
+
     /* Disable channel(s).  */
     ADC->ADC_CHDR = ~0;
+    mcu_pmc_release (ID_ADC);
     return samples * sizeof (adc_sample_t);
 }
 
@@ -502,8 +527,7 @@ adc_comparison_p (adc_t adc)
 void
 adc_shutdown (adc_t adc)
 {
-    /* TODO.  */
-    mcu_pmc_disable (ID_ADC);
+    adc_disable (adc);
 }
 
 
@@ -69,6 +69,7 @@ typedef struct adc_dev_struct
     uint32_t EMR;
     uint32_t CWR;
     bool tag;
+    bool enabled;
 } adc_dev_t;
 
 
@@ -160,6 +161,8 @@ Pdc *
 adc_pdc_get (adc_t adc);
 
 
+/** Keep the ADC clock running, say for triggered conversions with
+    DMA.  Otherwise, it is only enabled for each transfer.  */
 void
 adc_enable (adc_t adc);
 
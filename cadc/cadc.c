@@ -34,6 +34,7 @@ struct cadc_dev
     uint8_t last_channel;
     bool started;
     pdc_descriptor_t *descriptors;
+    pool_t *pool;
     volatile adc_sample_t **buffers;
     void *callback_data;
     cadc_callback_t callback_func;
@@ -56,6 +57,7 @@ void cadc_sync (cadc_t dev, uint8_t channel)
 }
 
 
+__ramfunc_if__ (MAT91LIB_RAMFUNC_ISR)
 static void
 cadc_isr (void)
 {
@@ -80,6 +82,69 @@ cadc_isr (void)
 }
 
 
+static void
+cadc_buffers_free (cadc_t dev)
+{
+    int i;
+
+    if (! dev->pool || ! dev->descriptors)
+        return;
+
+    for (i = 0; i < dev->num_buffers; i++)
+        pool_free (dev->pool, dev->descriptors[i].buffer);
+    pool_free (dev->pool, dev->descriptors);
+    dev->descriptors = 0;
+}
+
+
+static bool
+cadc_buffers_alloc (cadc_t dev, pool_t *pool)
+{
+    int i;
+
+    dev->pool = pool;
+
+    if (! pool)
+    {
+        dev->descriptors = calloc (dev->num_buffers,
+                                   sizeof (*dev->descriptors));
+        if (! dev->descriptors)
+            return 0;
+
+        for (i = 0; i < dev->num_buffers; i++)
+        {
+            dev->descriptors[i].buffer = calloc (dev->dma_size,
+                                                 sizeof (uint16_t));
+            if (! dev->descriptors[i].buffer)
+                return 0;
+        }
+        return 1;
+    }
+
+    if (pool_block_size_get (pool) < dev->dma_size * sizeof (uint16_t)
+        || pool_block_size_get (pool)
+        < dev->num_buffers * sizeof (*dev->descriptors))
+        return 0;
+
+    dev->descriptors = pool_calloc (pool);
+    if (! dev->descriptors)
+        return 0;
+
+    for (i = 0; i < dev->num_buffers; i++)
+    {
+        /* The buffers are overwritten by the DMA so need not be
+           zeroed.  */
+        dev->descriptors[i].buffer = pool_alloc (pool);
+        if (! dev->descriptors[i].buffer)
+        {
+            cadc_buffers_free (dev);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
 cadc_t cadc_init (const cadc_cfg_t *cfg)
 {
     int i;
@@ -89,6 +154,15 @@ cadc_t cadc_init (const cadc_cfg_t *cfg)
 
     dev->callback_func = 0;
 
+    /* Blocks from a previous initialisation are returned so that
+       reinitialisation does not leak.  The DMA must be stopped first
+       and the blocks freed before num_buffers is changed.  Buffers
+       from calloc are retained for the life of the program as
+       before.  */
+    if (dev->pdc)
+        cadc_stop (dev);
+    cadc_buffers_free (dev);
+
     dev->dma_size = cfg->dma_size;
     dev->num_buffers = cfg->num_buffers;
     if (dev->num_buffers < 3)
@@ -103,6 +177,9 @@ cadc_t cadc_init (const cadc_cfg_t *cfg)
     if (! dev->adc)
         return 0;
 
+    // Hold the ADC clock for the triggered conversions.
+    adc_enable (dev->adc);
+
     adc_calibrate (dev->adc);
 
     // Enable tagging of the data.  The four MSBs of each 16-bit sample
@@ -125,11 +202,11 @@ cadc_t cadc_init (const cadc_cfg_t *cfg)
     if (! dev->num_channels)
         return 0;
 
-    dev->descriptors = calloc (dev->num_buffers, sizeof (*dev->descriptors));
+    if (! cadc_buffers_alloc (dev, cfg->pool))
+        return 0;
 
     for (i = 0; i < dev->num_buffers; i++)
     {
-        dev->descriptors[i].buffer = calloc (dev->dma_size, sizeof (uint16_t));
         dev->descriptors[i].size = dev->dma_size;
         dev->descriptors[i].next = &dev->descriptors[(i + 1) % dev->num_buffers];
     }
@@ -145,6 +222,8 @@ cadc_t cadc_init (const cadc_cfg_t *cfg)
 
     ADC->ADC_IER = ADC_IER_ENDRX;
 
+    BOOT_PROFILE_MARK ("cadc_init");
+
     return dev;
 }
 
@@ -177,9 +256,8 @@ cadc_start (cadc_t dev)
 void
 cadc_stop (cadc_t dev)
 {
-    // adc_disable does nothing; the ADC runs on...
-    adc_disable (dev->adc);
-    // ... but the DMA is stopped
+    // The ADC runs on, keeping its clock, but the DMA is stopped.
+    // The clock is released by adc_shutdown.
     pdc_stop (dev->pdc);
 }
 
@@ -190,6 +268,7 @@ cadc_shutdown (cadc_t dev)
     cadc_stop (dev);
     adc_shutdown (dev->adc);
     tc_shutdown (dev->tc);
+    cadc_buffers_free (dev);
 }
 
 
@@ -16,6 +16,7 @@ extern "C" {
 #include "sys.h"
 #include "adc.h"
 #include "tc.h"
+#include "pool.h"
 
 
 typedef struct
@@ -25,6 +26,11 @@ typedef struct
     uint16_t dma_size;
     // Minimum 3.
     uint8_t num_buffers;
+    // Optional pool for the DMA buffers and descriptors, otherwise
+    // they are allocated with calloc.  The block size must be at
+    // least dma_size samples and the pool must have num_buffers + 1
+    // blocks free.
+    pool_t *pool;
 } cadc_cfg_t;
 
 
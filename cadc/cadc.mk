@@ -8,5 +8,6 @@ SRC += cadc.c
 include $(MAT91LIB_DIR)/adc/adc.mk
 include $(MAT91LIB_DIR)/tc/tc.mk
 include $(MAT91LIB_DIR)/pdc/pdc.mk
+include $(MAT91LIB_DIR)/pool/pool.mk
 
 
@@ -53,7 +53,9 @@ dac_reset (void)
 void
 dac_sleep (dac_t dac)
 {
+    mcu_pmc_acquire (ID_DACC);
     DACC->DACC_MR |= DACC_MR_SLEEP;
+    mcu_pmc_release (ID_DACC);
 }
 
 
@@ -177,10 +179,12 @@ dac_config (dac_t dac)
         return 1;
     dac_config_dirty = 0;
 
+    mcu_pmc_acquire (ID_DACC);
     dac_channels_select (dac);
 
     /* Set mode register.  */
     DACC->DACC_MR = dac->MR;
+    mcu_pmc_release (ID_DACC);
     return 1;
 }
 
@@ -221,14 +225,20 @@ dac_pdc_get (dac_t dac)
 void
 dac_enable (dac_t dac)
 {
-    /* Dummy function for symmetry with ssc driver.  */
+    if (dac->enabled)
+        return;
+    dac->enabled = 1;
+    mcu_pmc_acquire (ID_DACC);
 }
 
 
 void
 dac_disable (dac_t dac)
 {
-    /* Dummy function for symmetry with ssc driver.  */
+    if (! dac->enabled)
+        return;
+    dac->enabled = 0;
+    mcu_pmc_release (ID_DACC);
 }
 
 
@@ -247,19 +257,18 @@ dac_init (const dac_cfg_t *cfg)
     if (dac_devices_num >= DAC_DEVICES_NUM)
         return 0;
 
-    if (dac_devices_num == 0)
-    {
-        /* The clock only needs to be enabled when sampling.  The clock is
-           automatically started for the SAM7.  */
-        mcu_pmc_enable (ID_DACC);
+    /* The clock only needs to be enabled when sampling.  The clock is
+       automatically started for the SAM7.  */
+    mcu_pmc_acquire (ID_DACC);
 
+    if (dac_devices_num == 0)
         dac_reset ();
-    }
 
     dac = dac_devices + dac_devices_num;
     dac_devices_num++;
 
     dac->MR = 0;
+    dac->enabled = 0;
 
     if (!cfg)
         cfg = &dac_default_cfg;
@@ -269,6 +278,8 @@ dac_init (const dac_cfg_t *cfg)
     /* Note, the DAC is not configured until dac_config is called.  */
     dac_config (dac);
 
+    mcu_pmc_release (ID_DACC);
+
     return dac;
 }
 
@@ -305,20 +316,30 @@ dac_write (dac_t dac, void *buffer, uint16_t size)
     uint16_t samples;
     dac_sample_t *data;
 
+    mcu_pmc_acquire (ID_DACC);
     dac_config (dac);
 
     samples = size / sizeof (dac_sample_t);
     data = buffer;
 
+#if MCU_IDLE_WAIT
+    /* This wakes the core when the DAC is ready.  */
+    DACC->DACC_IER = DACC_IER_TXRDY;
+#endif
+
     for (i = 0; i < samples; i++)
     {
         /* Should have timeout, especially for external trigger.  */
-        while (!dac_ready_p (dac))
-            continue;
+        MCU_WAIT_UNTIL (dac_ready_p (dac), ID_DACC);
 
         DAC_WRITE (dac, data[i]);
     }
 
+#if MCU_IDLE_WAIT
+    DACC->DACC_IDR = DACC_IDR_TXRDY;
+#endif
+
+    mcu_pmc_release (ID_DACC);
     return samples * sizeof (dac_sample_t);
 }
 
@@ -326,6 +347,5 @@ dac_write (dac_t dac, void *buffer, uint16_t size)
 void
 dac_shutdown (dac_t dac)
 {
-    /* TODO.  */
-    mcu_pmc_disable (ID_DACC);
+    dac_disable (dac);
 }
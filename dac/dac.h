@@ -55,6 +55,7 @@ typedef struct dac_dev_struct
     uint16_t refresh_clocks;
     uint8_t bits;
     uint32_t MR;
+    bool enabled;
 } dac_dev_t;
 
 
@@ -140,6 +141,9 @@ Pdc *
 dac_pdc_get (dac_t dac);
 
 
+/** Keep the DAC clock running, say for triggered conversions with
+    DMA or to refresh the output between writes.  Otherwise, it is
+    only enabled for each transfer.  */
 void
 dac_enable (dac_t dac);
 
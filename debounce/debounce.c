@@ -0,0 +1,300 @@
+/** @file   debounce.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Debounced inputs for buttons and contacts.
+*/
+
+#include "debounce.h"
+#include "pio.h"
+#include "irq.h"
+
+
+/* The PIO debounce filter is clocked from the slow clock divided by
+   2 * (DIV + 1), where DIV is set in PIO_SCDR for each port.  Pulses
+   shorter than half the debounce period are rejected and pulses
+   longer than the debounce period are passed.  Thus an input change
+   interrupt only occurs once the input has settled.
+
+   If the port divider is already in use with a different period, the
+   input change interrupt is used to record when the input last
+   changed.  Once the input has not changed for the settle period,
+   its state is compared with the last reported state and an event is
+   generated if it differs.  This check is performed by debounce_poll
+   and debounce_read.  */
+
+
+#ifndef DEBOUNCE_DEVICES_NUM
+#define DEBOUNCE_DEVICES_NUM 8
+#endif
+
+
+#ifndef DEBOUNCE_EVENTS_NUM
+#define DEBOUNCE_EVENTS_NUM 16
+#endif
+
+
+#ifndef DEBOUNCE_PERIOD_MS
+#define DEBOUNCE_PERIOD_MS 20
+#endif
+
+
+#ifndef DEBOUNCE_IRQ_PRIORITY
+#define DEBOUNCE_IRQ_PRIORITY 10
+#endif
+
+
+#define DEBOUNCE_SLCK_FREQUENCY 32768
+
+#define DEBOUNCE_DIVIDER(PERIOD_MS) \
+    ((uint32_t)(PERIOD_MS) * DEBOUNCE_SLCK_FREQUENCY / 2000 - 1)
+
+#define DEBOUNCE_DIVIDER_MAX 0x3fff
+
+
+struct debounce_dev_struct
+{
+    pio_t pio;
+    sysclock_clocks_t settle_clocks;
+    /* Time of first change since last settled.  */
+    volatile sysclock_clocks_t edge;
+    /* Time of last change.  */
+    volatile sysclock_clocks_t changed;
+    volatile bool pending;
+    /* Last reported state.  */
+    volatile bool state;
+    bool filter;
+    bool active;
+};
+
+
+static debounce_dev_t debounce_devices[DEBOUNCE_DEVICES_NUM];
+static uint8_t debounce_devices_num = 0;
+
+static debounce_event_t debounce_events[DEBOUNCE_EVENTS_NUM];
+static volatile uint8_t debounce_events_in = 0;
+static volatile uint8_t debounce_events_out = 0;
+static uint32_t debounce_overruns = 0;
+
+
+/* This can be called from the PIO interrupt handler or from
+   debounce_poll so the queue needs protecting.  */
+static void
+debounce_event_push (debounce_t dev, bool state, sysclock_clocks_t clocks)
+{
+    irq_state_t irq_state;
+    uint8_t in;
+    uint8_t next;
+
+    irq_state = irq_global_save ();
+
+    in = debounce_events_in;
+    next = (in + 1) % DEBOUNCE_EVENTS_NUM;
+    if (next == debounce_events_out)
+    {
+        debounce_overruns++;
+    }
+    else
+    {
+        debounce_events[in].debounce = dev;
+        debounce_events[in].state = state;
+        debounce_events[in].clocks = clocks;
+        debounce_events_in = next;
+    }
+
+    irq_global_restore (irq_state);
+}
+
+
+static void
+debounce_irq_handler (void *arg, pio_t pio)
+{
+    debounce_t dev = arg;
+    sysclock_clocks_t now;
+
+    now = sysclock_clocks ();
+
+    if (dev->filter)
+    {
+        bool state;
+
+        /* The debounce filter has already rejected the bounces.  */
+        state = pio_input_get (pio);
+        if (state != dev->state)
+        {
+            dev->state = state;
+            debounce_event_push (dev, state, now);
+        }
+        return;
+    }
+
+    if (!dev->pending)
+        dev->edge = now;
+    dev->changed = now;
+    dev->pending = 1;
+}
+
+
+void
+debounce_poll (void)
+{
+    unsigned int i;
+
+    for (i = 0; i < debounce_devices_num; i++)
+    {
+        debounce_dev_t *dev = &debounce_devices[i];
+        sysclock_clocks_t edge;
+        irq_state_t irq_state;
+        bool state;
+
+        if (!dev->active || !dev->pending)
+            continue;
+
+        /* The times are updated by the interrupt handler and are not
+           read atomically.  */
+        irq_state = irq_global_save ();
+
+        if (sysclock_clocks () - dev->changed < dev->settle_clocks)
+        {
+            irq_global_restore (irq_state);
+            continue;
+        }
+
+        edge = dev->edge;
+        dev->pending = 0;
+
+        irq_global_restore (irq_state);
+
+        /* The input may have bounced back to its previous state.  */
+        state = pio_input_get (dev->pio);
+        if (state != dev->state)
+        {
+            dev->state = state;
+            debounce_event_push (dev, state, edge);
+        }
+    }
+}
+
+
+bool
+debounce_read (debounce_event_t *event)
+{
+    uint8_t out;
+
+    debounce_poll ();
+
+    out = debounce_events_out;
+    if (out == debounce_events_in)
+        return 0;
+
+    *event = debounce_events[out];
+    debounce_events_out = (out + 1) % DEBOUNCE_EVENTS_NUM;
+    return 1;
+}
+
+
+bool
+debounce_state_get (debounce_t dev)
+{
+    return dev->state;
+}
+
+
+bool
+debounce_filter_p (debounce_t dev)
+{
+    return dev->filter;
+}
+
+
+uint32_t
+debounce_overruns_get (void)
+{
+    return debounce_overruns;
+}
+
+
+debounce_t
+debounce_init (const debounce_cfg_t *cfg)
+{
+    debounce_dev_t *dev;
+    uint16_t period_ms;
+    uint32_t divider;
+    uint16_t current;
+    unsigned int i;
+
+    /* Reuse a slot released by debounce_shutdown.  */
+    dev = 0;
+    for (i = 0; i < debounce_devices_num; i++)
+    {
+        if (!debounce_devices[i].active)
+        {
+            dev = &debounce_devices[i];
+            break;
+        }
+    }
+
+    if (!dev)
+    {
+        if (debounce_devices_num >= DEBOUNCE_DEVICES_NUM)
+            return 0;
+        dev = &debounce_devices[debounce_devices_num];
+    }
+
+    period_ms = cfg->period_ms;
+    if (!period_ms)
+        period_ms = DEBOUNCE_PERIOD_MS;
+
+    dev->pio = cfg->pio;
+    dev->settle_clocks = (sysclock_clocks_t)period_ms * SYSCLOCK_MS_CLOCKS;
+    dev->pending = 0;
+
+    pio_config_set (dev->pio, cfg->config ? cfg->config : PIO_PULLUP);
+
+    /* The debounce divider is shared by all the PIOs on the same port
+       so only use the filter if the divider is unused or already set
+       to the desired value.  */
+    divider = DEBOUNCE_DIVIDER (period_ms);
+    current = pio_debounce_divider_get (dev->pio);
+    dev->filter = divider <= DEBOUNCE_DIVIDER_MAX
+        && (current == 0 || current == divider);
+
+    if (dev->filter)
+    {
+        pio_debounce_divider_set (dev->pio, divider);
+        pio_debounce_filter_enable (dev->pio);
+    }
+    else
+    {
+        /* This reduces the number of spurious interrupts.  */
+        pio_glitch_filter_enable (dev->pio);
+    }
+
+    dev->state = pio_input_get (dev->pio);
+
+    pio_irq_config_set (dev->pio, PIO_IRQ_ANY_EDGE);
+    if (!pio_irq_handler_set (dev->pio, DEBOUNCE_IRQ_PRIORITY,
+                              debounce_irq_handler, dev))
+        return 0;
+
+    dev->active = 1;
+    if (dev == &debounce_devices[debounce_devices_num])
+        debounce_devices_num++;
+
+    /* Note, PIO_ISR is not read to clear a stale input change since
+       this would lose the changes for other PIOs on the same port.  A
+       stale change is harmless since the state is compared with the
+       last reported state.  */
+    pio_irq_enable (dev->pio);
+
+    return dev;
+}
+
+
+void
+debounce_shutdown (debounce_t dev)
+{
+    pio_irq_handler_clear (dev->pio);
+    pio_input_filter_disable (dev->pio);
+    dev->pending = 0;
+    dev->active = 0;
+}
@@ -0,0 +1,92 @@
+/** @file   debounce.h
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Debounced inputs for buttons and contacts.
+    @note   Where possible, the PIO debounce filter is used so that an
+    input change interrupt only occurs for a clean edge.  Since the
+    debounce period is shared by all the PIOs on a port, the other
+    inputs use input change interrupts with a settle period
+    measured using sysclock.  The debounced edges are queued as
+    events.
+*/
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "config.h"
+#include "pio.h"
+#include "sysclock.h"
+
+
+/** Debounce configuration structure.  */
+typedef struct debounce_cfg_struct
+{
+    pio_t pio;
+    /* PIO_INPUT or PIO_PULLUP.  Zero defaults to PIO_PULLUP.  */
+    pio_config_t config;
+    /* Settle period in ms.  Zero defaults to DEBOUNCE_PERIOD_MS.  */
+    uint16_t period_ms;
+} debounce_cfg_t;
+
+
+typedef struct debounce_dev_struct debounce_dev_t;
+
+typedef debounce_dev_t *debounce_t;
+
+
+/** Debounced edge event.  */
+typedef struct debounce_event_struct
+{
+    debounce_t debounce;
+    /* Input state after the edge.  */
+    bool state;
+    /* Time that the edge was detected.  */
+    sysclock_clocks_t clocks;
+} debounce_event_t;
+
+
+/** Initialise debounced input.  */
+debounce_t
+debounce_init (const debounce_cfg_t *cfg);
+
+
+/** Return the debounced input state.  */
+bool
+debounce_state_get (debounce_t debounce);
+
+
+/** Return true if the hardware debounce filter is used.  */
+bool
+debounce_filter_p (debounce_t debounce);
+
+
+/** Check inputs that use a settle period.  This is also called by
+    debounce_read but can be called from a periodic callback, say
+    from sysclock, to generate events promptly.  */
+void
+debounce_poll (void);
+
+
+/** Read next event.  Return false if no event is available.  */
+bool
+debounce_read (debounce_event_t *event);
+
+
+/** Return the number of events lost due to the queue being full.  */
+uint32_t
+debounce_overruns_get (void);
+
+
+void
+debounce_shutdown (debounce_t debounce);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
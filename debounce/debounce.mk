@@ -0,0 +1,8 @@
+DEBOUNCE_DIR = $(MAT91LIB_DIR)/debounce
+
+VPATH += $(DEBOUNCE_DIR)
+INCLUDES += -I$(DEBOUNCE_DIR)
+
+SRC += debounce.c
+
+include $(MAT91LIB_DIR)/sysclock/sysclock.mk
@@ -23,6 +23,16 @@ extern "C" {
 #endif
 
 
+/* With DELAY_CALIBRATE, the loop count is computed at run time from
+   the loop time measured by mcu_init rather than from
+   DELAY_LOOP_CYCLES.  This costs a multiply.  It is only supported
+   on the SAM4S and should be enabled if MCK is changed with
+   mcu_clock_set since the fixed loop count assumes F_CPU.  */
+#ifndef DELAY_CALIBRATE
+#define DELAY_CALIBRATE 0
+#endif
+
+
 // Ensure constant folding optimization
 __attribute__((optimize (2)))
 __always_inline__
@@ -40,13 +50,27 @@ static inline unsigned int _delay_us_loops (double delay_us)
 }
 
     
+// Ensure constant folding optimization
+__attribute__((optimize (2)))
+__always_inline__
+static inline uint32_t _delay_us_clocks (double delay_us)
+{
+    return (uint32_t)((double)F_CPU * (delay_us) / 1e6);
+}
+
+
 __attribute__((optimize (2)))
 __always_inline__
 static inline void DELAY_US (double delay_us)
 {
     unsigned int ticks;                      
 
+#if DELAY_CALIBRATE
+    ticks = ((uint64_t)_delay_us_clocks (delay_us)
+             * mcu_delay_loop_scale) >> 16;
+#else
     ticks = _delay_us_loops (delay_us);
+#endif
     mcu_delay_loop (ticks);
 }
 
@@ -0,0 +1,151 @@
+/** @file   dpc.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Deferred procedure calls.
+*/
+
+#include "dpc.h"
+#include "irq.h"
+
+
+/* Each priority level has a list of posted DPCs.  Posting pushes the
+   DPC onto the list with LDREX/STREX and pends PendSV.  The PendSV
+   handler removes a whole list at once, reverses it so the DPCs are
+   run in the order posted, and runs them.  It then looks again for
+   the highest priority posted DPC.  Thus a DPC does not preempt
+   another DPC but the higher priority DPCs are run first.
+
+   The posted flag prevents a DPC being pushed onto a list twice.  It
+   is cleared before the handler is called so that the DPC can be
+   posted again while it is running.  */
+
+
+/* PendSV should have the lowest priority so that it does not delay
+   other interrupts.  */
+#ifndef DPC_IRQ_PRIORITY
+#define DPC_IRQ_PRIORITY 15
+#endif
+
+
+static dpc_t * volatile dpc_lists[DPC_PRIORITIES];
+
+
+/* Atomically remove the list for the specified priority.  */
+static dpc_t *
+dpc_list_take (unsigned int priority)
+{
+    volatile uint32_t *addr = (volatile uint32_t *)&dpc_lists[priority];
+    uint32_t head;
+
+    do
+    {
+        head = __LDREXW (addr);
+    } while (__STREXW (0, addr));
+
+    return (dpc_t *)head;
+}
+
+
+static void
+dpc_handler (void)
+{
+    unsigned int priority;
+
+    priority = 0;
+    while (priority < DPC_PRIORITIES)
+    {
+        dpc_t *list;
+        dpc_t *fifo;
+        dpc_t *next;
+
+        if (!dpc_lists[priority])
+        {
+            priority++;
+            continue;
+        }
+
+        list = dpc_list_take (priority);
+
+        /* The list is last in, first out so reverse it.  */
+        fifo = 0;
+        for (; list; list = next)
+        {
+            next = list->next;
+            list->next = fifo;
+            fifo = list;
+        }
+
+        for (; fifo; fifo = next)
+        {
+            /* The DPC may be reposted once the flag is cleared and this
+               overwrites its next pointer.  */
+            next = fifo->next;
+            __DMB ();
+            fifo->posted = 0;
+            fifo->handler (fifo->arg);
+        }
+
+        /* A higher priority DPC may have been posted.  */
+        priority = 0;
+    }
+}
+
+
+bool
+dpc_post (dpc_t *dpc)
+{
+    volatile uint32_t *addr;
+    unsigned int priority;
+    uint32_t head;
+
+    /* Atomically set the posted flag.  */
+    do
+    {
+        if (__LDREXW (&dpc->posted))
+        {
+            __CLREX ();
+            return 0;
+        }
+    } while (__STREXW (1, &dpc->posted));
+
+    /* Push onto the list.  */
+    priority = dpc->priority;
+    if (priority >= DPC_PRIORITIES)
+        priority = DPC_PRIORITIES - 1;
+    addr = (volatile uint32_t *)&dpc_lists[priority];
+    do
+    {
+        head = __LDREXW (addr);
+        dpc->next = (dpc_t *)head;
+    } while (__STREXW ((uint32_t)dpc, addr));
+
+    irq_trigger (PendSV_IRQn);
+    return 1;
+}
+
+
+bool
+dpc_posted_p (dpc_t *dpc)
+{
+    return dpc->posted != 0;
+}
+
+
+void
+dpc_setup (dpc_t *dpc, dpc_handler_t handler, void *arg, uint8_t priority)
+{
+    dpc->handler = handler;
+    dpc->arg = arg;
+    if (priority >= DPC_PRIORITIES)
+        priority = DPC_PRIORITIES - 1;
+    dpc->priority = priority;
+    dpc->posted = 0;
+    dpc->next = 0;
+}
+
+
+void
+dpc_init (void)
+{
+    irq_config (PendSV_IRQn, DPC_IRQ_PRIORITY, dpc_handler);
+}
@@ -0,0 +1,77 @@
+/** @file   dpc.h
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Deferred procedure calls.
+    @note   An interrupt handler can post a deferred procedure call
+    (DPC) to perform lengthy processing outside the handler.  The DPCs
+    are run by the PendSV handler at the lowest interrupt priority so
+    they are preempted by all the other interrupts.  Posting is lock
+    free and can be performed from any interrupt priority.
+*/
+
+#ifndef DPC_H
+#define DPC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "config.h"
+
+
+/* Number of DPC priority levels.  */
+#ifndef DPC_PRIORITIES
+#define DPC_PRIORITIES 4
+#endif
+
+
+typedef void (*dpc_handler_t) (void *arg);
+
+
+/** DPC object.  This is usually statically allocated by the driver
+    and must not be modified while posted.  */
+typedef struct dpc_struct
+{
+    dpc_handler_t handler;
+    void *arg;
+    /* 0 is the highest priority.  */
+    uint8_t priority;
+    /* The following are private.  */
+    volatile uint32_t posted;
+    struct dpc_struct * volatile next;
+} dpc_t;
+
+
+/** Define and initialise a DPC object.  */
+#define DPC_DEFINE(NAME, HANDLER, ARG, PRIORITY) \
+    dpc_t NAME = {.handler = (HANDLER), .arg = (ARG), .priority = (PRIORITY)}
+
+
+/** Initialise a DPC object.  */
+void
+dpc_setup (dpc_t *dpc, dpc_handler_t handler, void *arg, uint8_t priority);
+
+
+/** Post DPC for running.  This can be called from an interrupt
+    handler.  Return false if the DPC is already posted and has not
+    started; in this case the posts are combined and the handler is
+    only called once.  */
+bool
+dpc_post (dpc_t *dpc);
+
+
+/** Return true if the DPC is posted but has not started.  */
+bool
+dpc_posted_p (dpc_t *dpc);
+
+
+/** Initialise the DPC handler.  This installs the PendSV handler.  */
+void
+dpc_init (void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,6 @@
+DPC_DIR = $(MAT91LIB_DIR)/dpc
+
+VPATH += $(DPC_DIR)
+INCLUDES += -I$(DPC_DIR)
+
+SRC += dpc.c
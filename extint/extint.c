@@ -7,17 +7,55 @@
 #include "extint.h"
 #include "pio.h"
 #include "mcu.h"
+#include "cpu.h"
 #include "irq.h"
 
 
+/* On the SAM7, the external interrupts are the IRQ0 and IRQ1 pins
+   handled by the AIC.  On the SAM4S, any PIO can be used with an
+   input change interrupt.  These are dispatched by the common PIO
+   port handler.  */
+
+
+#ifndef EXTINT_DEVICES_NUM
+#define EXTINT_DEVICES_NUM 4
+#endif
+
+
+/* Priority used if none is configured.  */
+#ifndef EXTINT_IRQ_PRIORITY
+#define EXTINT_IRQ_PRIORITY 1
+#endif
+
+
+#define EXTINT_PRIORITY(CFG) \
+    ((CFG)->priority ? (CFG)->priority : EXTINT_IRQ_PRIORITY)
+
+
 struct extint_dev_struct
 {
     pio_t pio;
+    void (*handler)(void);
+    volatile uint32_t timestamp;
+    volatile uint32_t count;
+#ifdef __SAM7__
     irq_id_t irq_id;
     pio_config_t periph;
+#endif
 };
 
 
+static void
+extint_default_handler (void)
+{
+    /* Nothing to do.  */
+}
+
+
+#ifdef __SAM7__
+static void extint_handler0 (void);
+static void extint_handler1 (void);
+
 static extint_dev_t extints[] =
 {
     {
@@ -36,9 +74,18 @@ static extint_dev_t extints[] =
 
 
 static void
-extint_default_handler (void)
+extint_handler0 (void)
 {
-    /* Nothing to do.  */
+    extints[0].count++;
+    extints[0].handler ();
+}
+
+
+static void
+extint_handler1 (void)
+{
+    extints[1].count++;
+    extints[1].handler ();
 }
 
 
@@ -57,11 +104,11 @@ void extint_disable (extint_t extint)
 void extint_sleep (extint_t extint)
 {
     extint_enable (extint);
-    
+
     /* Turn off main oscillator, PLL, and master clock, switch to slow
        clock, and sleep until get an external interrupt.  */
     mcu_sleep ();
-    
+
     extint_disable (extint);
 }
 
@@ -74,18 +121,18 @@ extint_t extint_init (const extint_cfg_t *cfg)
     for (i = 0; i < EXTINT_NUM; i++)
     {
         dev = &extints[i];
-        
+
         if (dev->pio == cfg->pio)
         {
-            void (*handler)(void);
-
             pio_config_set (dev->pio, dev->periph);
 
-            handler = cfg->handler;
-            if (!handler)
-                handler = extint_default_handler;
-            
-            irq_config (dev->irq_id, 1, handler);
+            dev->handler = cfg->handler;
+            if (!dev->handler)
+                dev->handler = extint_default_handler;
+            dev->count = 0;
+
+            irq_config (dev->irq_id, EXTINT_PRIORITY (cfg),
+                        i == 0 ? extint_handler0 : extint_handler1);
 
             return dev;
         }
@@ -93,4 +140,112 @@ extint_t extint_init (const extint_cfg_t *cfg)
     return 0;
 }
 
+#else
+
+static extint_dev_t extints[EXTINT_DEVICES_NUM];
+static uint8_t extints_num = 0;
+
 
+static void
+extint_handler (void *arg, pio_t pio)
+{
+    extint_dev_t *dev = arg;
+
+    /* Sample the time first to minimise jitter.  */
+    dev->timestamp = cpu_cycle_counter_get ();
+    dev->count++;
+    dev->handler ();
+}
+
+
+void extint_enable (extint_t extint)
+{
+    pio_irq_enable (extint->pio);
+}
+
+
+void extint_disable (extint_t extint)
+{
+    pio_irq_disable (extint->pio);
+}
+
+
+void extint_sleep (extint_t extint)
+{
+    uint32_t count;
+    irq_state_t irq_state;
+
+    count = extint->count;
+    extint_enable (extint);
+
+    while (1)
+    {
+        /* Mask interrupts while checking for the external interrupt
+           so that it cannot occur between the check and the WFI.  A
+           pending interrupt still wakes the CPU and is serviced once
+           interrupts are unmasked.  */
+        irq_state = irq_global_save ();
+        if (extint->count != count)
+            break;
+        cpu_wfi ();
+        irq_global_restore (irq_state);
+    }
+    irq_global_restore (irq_state);
+
+    extint_disable (extint);
+}
+
+
+extint_t extint_init (const extint_cfg_t *cfg)
+{
+    unsigned int i;
+    extint_dev_t *dev;
+
+    dev = 0;
+    for (i = 0; i < extints_num; i++)
+    {
+        if (extints[i].pio == cfg->pio)
+            dev = &extints[i];
+    }
+
+    if (!dev)
+    {
+        if (extints_num >= EXTINT_DEVICES_NUM)
+            return 0;
+        dev = &extints[extints_num];
+    }
+
+    dev->pio = cfg->pio;
+    dev->handler = cfg->handler;
+    if (!dev->handler)
+        dev->handler = extint_default_handler;
+    dev->count = 0;
+    dev->timestamp = 0;
+
+    pio_config_set (dev->pio, PIO_PULLUP);
+    pio_irq_config_set (dev->pio, cfg->irq_config ? cfg->irq_config
+                        : PIO_IRQ_FALLING_EDGE);
+
+    if (!pio_irq_handler_set (dev->pio, EXTINT_PRIORITY (cfg),
+                              extint_handler, dev))
+        return 0;
+
+    if (dev == &extints[extints_num])
+        extints_num++;
+
+    return dev;
+}
+
+#endif
+
+
+uint32_t extint_timestamp_get (extint_t extint)
+{
+    return extint->timestamp;
+}
+
+
+uint32_t extint_count_get (extint_t extint)
+{
+    return extint->count;
+}
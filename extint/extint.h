@@ -10,15 +10,24 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
-    
+
 
 #include "config.h"
 #include "pio.h"
+#include "irq.h"
 
 typedef struct extint_cfg_struct
 {
     pio_t pio;
     void (*handler)(void);
+    /* Interrupt priority.  Zero defaults to EXTINT_IRQ_PRIORITY.  On
+       the SAM4S this is shared by all the PIOs on the same port.  */
+    irq_priority_t priority;
+#ifdef __SAM4S__
+    /* Edge or level sensitivity.  Zero defaults to
+       PIO_IRQ_FALLING_EDGE.  */
+    pio_irq_config_t irq_config;
+#endif
 } extint_cfg_t;
 
 
@@ -33,12 +42,23 @@ void extint_enable (extint_t extint);
 
 void extint_disable (extint_t extint);
 
+/** Stop the CPU clock until the external interrupt occurs.  Other
+    interrupts are serviced but do not cause a return.  On the SAM4S,
+    the peripheral clocks keep running so the wake latency is the
+    interrupt latency (12 CPU clocks plus the PIO input
+    synchronisation of 2 MCK clocks).  */
 void extint_sleep (extint_t extint);
 
+/** Return cycle counter value when the last interrupt occurred
+    (SAM4S only).  This is sampled on entry to the handler.  */
+uint32_t extint_timestamp_get (extint_t extint);
+
+/** Return number of interrupts.  */
+uint32_t extint_count_get (extint_t extint);
+
 
 #ifdef __cplusplus
 }
-#endif    
 #endif
-
+#endif
 
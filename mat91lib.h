@@ -36,6 +36,50 @@ extern "C" {
 #endif
 
 
+/* Place a function in SRAM.  It is copied from flash by the C
+   runtime startup along with the initialised data.  This avoids the
+   flash wait states and makes the execution time deterministic.
+   Since SRAM is out of range of a branch from flash, callers in other
+   files need to see the declaration with this attribute.  */
+#ifndef __ramfunc__
+#define __ramfunc__ __attribute__ ((section (".ramfunc"), noinline, long_call))
+#endif
+
+
+/* Hot functions are tagged with __ramfunc_if__ (CLASS) where CLASS
+   is one of the following.  These must be defined as 0 or 1.  Say
+   define MAT91LIB_RAMFUNC_ISR as 1 in config.h to place the tagged
+   interrupt handlers in SRAM.  Use make ramfunc-size to show the
+   SRAM cost.  */
+#ifndef MAT91LIB_RAMFUNC
+#define MAT91LIB_RAMFUNC 0
+#endif
+
+/* Interrupt service routines.  */
+#ifndef MAT91LIB_RAMFUNC_ISR
+#define MAT91LIB_RAMFUNC_ISR MAT91LIB_RAMFUNC
+#endif
+
+/* Data transfer loops.  */
+#ifndef MAT91LIB_RAMFUNC_LOOP
+#define MAT91LIB_RAMFUNC_LOOP MAT91LIB_RAMFUNC
+#endif
+
+#define __ramfunc_if_0__
+#define __ramfunc_if_1__ __ramfunc__
+#define __ramfunc_if_expand__(ENABLE) __ramfunc_if_ ## ENABLE ## __
+#define __ramfunc_if__(ENABLE) __ramfunc_if_expand__ (ENABLE)
+
+
+/* Place a variable in the .noinit section.  This is not zeroed on
+   reset so it is useful for large buffers where the startup time to
+   clear them is not wanted.  The variable must not have an
+   initialiser.  */
+#ifndef __noinit__
+#define __noinit__ __attribute__ ((section (".noinit")))
+#endif
+
+
 #ifndef _DOXYGEN_
 #define __packed__ __attribute__((packed))
 #else
@@ -70,6 +70,7 @@ LD = $(TOOLCHAIN)-gcc
 CC = $(TOOLCHAIN)-gcc
 OBJCOPY = $(TOOLCHAIN)-objcopy
 SIZE = $(TOOLCHAIN)-size
+NM = $(TOOLCHAIN)-nm
 DEL = rm -f
 
 ifeq ($(RUN_MODE), RAM)
@@ -148,6 +149,20 @@ $(TARGET): $(OBJS)
 	$(Q)$(LD) $(LDFLAGS) -o $@  $^ $(LDLIBS) -Wl,-Map=$(TARGET_MAP),--cref
 	$(SIZE) $@
 
+# Show the SRAM used by code relocated from flash, see __ramfunc__.
+.PHONY: ramfunc-size
+ramfunc-size: $(TARGET)
+	@$(NM) -S -n $< | awk '\
+	{line[NR] = $$0} \
+	/ __ramfunc_start__$$/ {start = $$1} \
+	/ __ramfunc_end__$$/ {end = $$1} \
+	END {for (i = 1; i <= NR; i++) \
+	    if (split (line[i], f) == 4 && f[1] >= start && f[1] < end) \
+	        print f[2], f[4]}'
+	@start=`$(NM) $< | grep ' __ramfunc_start__$$' | cut -d ' ' -f 1`; \
+	end=`$(NM) $< | grep ' __ramfunc_end__$$' | cut -d ' ' -f 1`; \
+	echo "ramfunc: $$((0x$$end - 0x$$start)) bytes"
+
 # Remove non-source files.
 .PHONY: clean
 clean:
@@ -102,6 +102,14 @@ pdc_descriptor_t *
 pdc_write_poll (pdc_t pdc);
 
 
+void
+pdc_write_config (pdc_t pdc, pdc_descriptor_t *tx);
+
+
+void
+pdc_read_config (pdc_t pdc, pdc_descriptor_t *rx);
+
+
 void
 pdc_config (pdc_t pdc, pdc_descriptor_t *tx, pdc_descriptor_t *rx);
 
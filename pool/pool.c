@@ -0,0 +1,130 @@
+/** @file   pool.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Fixed-block memory pools.
+*/
+
+#include <string.h>
+#include "pool.h"
+#include "irq.h"
+
+
+/* Free blocks are linked through their first word.  Blocks that have
+   never been allocated are not on the free list; instead they are
+   handed out in order using blocks_used.  Thus neither initialisation
+   nor allocation needs to walk the pool.  */
+
+
+bool
+pool_setup (pool_t *pool, void *memory, size_t size,
+            uint16_t block_size, uint16_t align)
+{
+    size_t blocks;
+
+    if (align < sizeof (void *))
+        align = sizeof (void *);
+
+    block_size = POOL_BLOCK_SIZE (block_size, align);
+    blocks = block_size ? size / block_size : 0;
+    if (blocks > UINT16_MAX)
+        blocks = UINT16_MAX;
+
+    pool->memory = memory;
+    pool->block_size = block_size;
+    pool->blocks = blocks;
+    pool->blocks_used = 0;
+    pool->free_num = blocks;
+    pool->free_min = blocks;
+    pool->free_list = 0;
+
+    return blocks != 0 && ((uintptr_t)memory & (align - 1)) == 0;
+}
+
+
+void *
+pool_alloc (pool_t *pool)
+{
+    irq_state_t irq_state;
+    void *block;
+
+    irq_state = irq_global_save ();
+
+    block = pool->free_list;
+    if (block)
+        pool->free_list = *(void **)block;
+    else if (pool->blocks_used < pool->blocks)
+        block = pool->memory + pool->blocks_used++ * pool->block_size;
+
+    if (block)
+    {
+        pool->free_num--;
+        if (pool->free_num < pool->free_min)
+            pool->free_min = pool->free_num;
+    }
+
+    irq_global_restore (irq_state);
+
+    return block;
+}
+
+
+void *
+pool_calloc (pool_t *pool)
+{
+    void *block;
+
+    block = pool_alloc (pool);
+    if (block)
+        memset (block, 0, pool->block_size);
+    return block;
+}
+
+
+void
+pool_free (pool_t *pool, void *block)
+{
+    irq_state_t irq_state;
+
+    if (!block)
+        return;
+
+    irq_state = irq_global_save ();
+
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->free_num++;
+
+    irq_global_restore (irq_state);
+}
+
+
+bool
+pool_contains_p (pool_t *pool, void *block)
+{
+    uint8_t *ptr = block;
+
+    return ptr >= pool->memory
+        && ptr < pool->memory + pool->blocks * pool->block_size
+        && (ptr - pool->memory) % pool->block_size == 0;
+}
+
+
+uint16_t
+pool_block_size_get (pool_t *pool)
+{
+    return pool->block_size;
+}
+
+
+uint16_t
+pool_free_get (pool_t *pool)
+{
+    return pool->free_num;
+}
+
+
+uint16_t
+pool_free_min_get (pool_t *pool)
+{
+    return pool->free_min;
+}
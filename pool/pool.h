@@ -0,0 +1,116 @@
+/** @file   pool.h
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Fixed-block memory pools.
+    @note   A pool is a statically allocated array of equal sized
+    blocks.  Allocation and freeing take constant time and can be
+    performed from interrupt handlers.  Unlike malloc, a pool cannot
+    fragment and each block has a known alignment, so pools are
+    suitable for DMA buffers and driver objects.  The blocks are not
+    zeroed.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "config.h"
+
+
+/* Default block alignment.  This must be a power of 2 and at least
+   the size of a pointer since a free block holds the free list
+   link.  */
+#ifndef POOL_ALIGN
+#define POOL_ALIGN 4
+#endif
+
+
+/** Pool object.  The fields are private.  */
+typedef struct pool_struct
+{
+    uint8_t *memory;
+    uint16_t block_size;
+    uint16_t blocks;
+    /* Number of blocks that have been allocated at least once.  The
+       remaining blocks are allocated in order without needing the
+       free list to be built at initialisation.  */
+    uint16_t blocks_used;
+    uint16_t free_num;
+    uint16_t free_min;
+    void *free_list;
+} pool_t;
+
+
+/** Block size rounded up to a multiple of the alignment.  */
+#define POOL_BLOCK_SIZE(SIZE, ALIGN) \
+    (((SIZE) + (ALIGN) - 1) & ~((ALIGN) - 1))
+
+
+/** Define and initialise a pool object NAME with BLOCKS blocks, each
+    of at least SIZE bytes and aligned to ALIGN bytes.  The storage is
+    placed in the .noinit section of SRAM so that it is accessible by
+    the PDC and does not add to the startup time.  */
+#define POOL_DEFINE(NAME, SIZE, BLOCKS, ALIGN)                          \
+    static uint8_t NAME ## _memory[POOL_BLOCK_SIZE (SIZE, ALIGN) * (BLOCKS)] \
+    __noinit__ __attribute__ ((aligned (ALIGN)));                       \
+    pool_t NAME = {.memory = NAME ## _memory,                           \
+                   .block_size = POOL_BLOCK_SIZE (SIZE, ALIGN),         \
+                   .blocks = (BLOCKS),                                  \
+                   .free_num = (BLOCKS),                                \
+                   .free_min = (BLOCKS)}
+
+
+/** Initialise a pool object using the memory pointed to by MEMORY of
+    SIZE bytes.  MEMORY must be aligned to ALIGN bytes.  Return false
+    if the memory cannot hold a block.  */
+bool
+pool_setup (pool_t *pool, void *memory, size_t size,
+            uint16_t block_size, uint16_t align);
+
+
+/** Allocate a block.  Return 0 if the pool is empty.  This can be
+    called from an interrupt handler.  */
+void *
+pool_alloc (pool_t *pool);
+
+
+/** Allocate a block and zero it.  */
+void *
+pool_calloc (pool_t *pool);
+
+
+/** Return a block to the pool.  This can be called from an interrupt
+    handler.  A null pointer is ignored.  */
+void
+pool_free (pool_t *pool, void *block);
+
+
+/** Return true if BLOCK belongs to the pool.  */
+bool
+pool_contains_p (pool_t *pool, void *block);
+
+
+/** Return the usable size of each block in bytes.  */
+uint16_t
+pool_block_size_get (pool_t *pool);
+
+
+/** Return the number of free blocks.  */
+uint16_t
+pool_free_get (pool_t *pool);
+
+
+/** Return the smallest number of free blocks since the pool was
+    initialised.  This is useful for sizing the pool.  */
+uint16_t
+pool_free_min_get (pool_t *pool);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,6 @@
+POOL_DIR = $(MAT91LIB_DIR)/pool
+
+VPATH += $(POOL_DIR)
+INCLUDES += -I$(POOL_DIR)
+
+SRC += pool.c
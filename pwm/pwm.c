@@ -34,6 +34,8 @@ struct pwm_dev_struct
 
 static pwm_dev_t pwm_devices[PWM_DEVICES_NUM];
 
+static bool pwm_clock_acquired = 0;
+
 
 /* Define known PWMH pins, grouped by channel.  */
 static const pinmap_t pwm_pins[] =
@@ -82,7 +84,9 @@ void
 pwm_shutdown (void)
 {
     /* Disable PWM peripheral clock.  */
-    mcu_pmc_disable (ID_PWM);
+    if (pwm_clock_acquired)
+        mcu_pmc_release (ID_PWM);
+    pwm_clock_acquired = 0;
 }
 
 
@@ -315,8 +319,10 @@ pwm_init (const pwm_cfg_t *cfg)
     pwm->period = 0;
 
     /* Enable PWM peripheral clock (this is not required to configure
-       the PWM).  */
-    mcu_pmc_enable (ID_PWM);
+       the PWM).  The clock is shared by all the channels.  */
+    if (!pwm_clock_acquired)
+        mcu_pmc_acquire (ID_PWM);
+    pwm_clock_acquired = 1;
 
     pwm_stop (pwm);
 
@@ -0,0 +1,219 @@
+/** @file   runloop.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Run to completion event loop.
+*/
+
+#include "runloop.h"
+#include "cpu.h"
+#include "irq.h"
+
+
+/* Events can be posted from interrupt handlers of any priority so
+   the queue is updated with interrupts masked.  This only takes a few
+   instructions.  Since the events are only removed by the loop, the
+   removal does not need masking.
+
+   Each event is timestamped with the cycle counter when posted so
+   that the dispatch latency can be measured.  */
+
+
+#ifndef RUNLOOP_EVENTS_NUM
+#define RUNLOOP_EVENTS_NUM 16
+#endif
+
+
+#ifndef RUNLOOP_POLLERS_NUM
+#define RUNLOOP_POLLERS_NUM 4
+#endif
+
+
+typedef struct runloop_event_struct
+{
+    runloop_handler_t handler;
+    void *arg;
+    uint32_t data;
+    uint32_t posted;
+} runloop_event_t;
+
+
+typedef struct runloop_poll_struct
+{
+    runloop_poller_t poller;
+    void *arg;
+} runloop_poll_t;
+
+
+static runloop_event_t runloop_events[RUNLOOP_EVENTS_NUM];
+static volatile uint8_t runloop_events_in = 0;
+static volatile uint8_t runloop_events_out = 0;
+
+static runloop_poll_t runloop_polls[RUNLOOP_POLLERS_NUM];
+static uint8_t runloop_polls_num = 0;
+
+static runloop_stats_t runloop_stats;
+
+
+bool
+runloop_post (runloop_handler_t handler, void *arg, uint32_t data)
+{
+    irq_state_t irq_state;
+    uint8_t in;
+    uint8_t next;
+    uint8_t depth;
+    bool ret;
+
+    irq_state = irq_global_save ();
+
+    in = runloop_events_in;
+    next = (in + 1) % RUNLOOP_EVENTS_NUM;
+    if (next == runloop_events_out)
+    {
+        runloop_stats.overruns++;
+        ret = 0;
+    }
+    else
+    {
+        runloop_events[in].handler = handler;
+        runloop_events[in].arg = arg;
+        runloop_events[in].data = data;
+        runloop_events[in].posted = cpu_cycle_counter_get ();
+        runloop_events_in = next;
+
+        depth = (next + RUNLOOP_EVENTS_NUM - runloop_events_out)
+            % RUNLOOP_EVENTS_NUM;
+        if (depth > runloop_stats.depth_max)
+            runloop_stats.depth_max = depth;
+        ret = 1;
+    }
+
+    irq_global_restore (irq_state);
+    return ret;
+}
+
+
+static void
+runloop_timer_callback (void *arg)
+{
+    runloop_timer_t *timer = arg;
+
+    runloop_post (timer->handler, timer->arg, 0);
+}
+
+
+void
+runloop_timer_start (runloop_timer_t *timer, uint32_t delay_ms,
+                     uint32_t period_ms, runloop_handler_t handler,
+                     void *arg)
+{
+    timer->handler = handler;
+    timer->arg = arg;
+    sysclock_timer_start (&timer->timer,
+                          (sysclock_clocks_t)delay_ms * SYSCLOCK_MS_CLOCKS,
+                          (sysclock_clocks_t)period_ms * SYSCLOCK_MS_CLOCKS,
+                          runloop_timer_callback, timer);
+}
+
+
+void
+runloop_timer_stop (runloop_timer_t *timer)
+{
+    sysclock_timer_stop (&timer->timer);
+}
+
+
+bool
+runloop_poller_add (runloop_poller_t poller, void *arg)
+{
+    if (runloop_polls_num >= RUNLOOP_POLLERS_NUM)
+        return 0;
+
+    runloop_polls[runloop_polls_num].poller = poller;
+    runloop_polls[runloop_polls_num].arg = arg;
+    runloop_polls_num++;
+    return 1;
+}
+
+
+bool
+runloop_dispatch (void)
+{
+    bool dispatched = 0;
+    unsigned int i;
+
+    while (runloop_events_out != runloop_events_in)
+    {
+        runloop_event_t event;
+        uint32_t latency;
+
+        /* Copy the event so that the slot can be reused while the
+           handler runs.  */
+        event = runloop_events[runloop_events_out];
+        runloop_events_out = (runloop_events_out + 1) % RUNLOOP_EVENTS_NUM;
+
+        latency = cpu_cycle_counter_get () - event.posted;
+        runloop_stats.events++;
+        runloop_stats.latency_total += latency;
+        if (latency > runloop_stats.latency_max)
+            runloop_stats.latency_max = latency;
+
+        event.handler (event.arg, event.data);
+        dispatched = 1;
+    }
+
+    for (i = 0; i < runloop_polls_num; i++)
+        runloop_polls[i].poller (runloop_polls[i].arg);
+
+    return dispatched;
+}
+
+
+void
+runloop_run (void)
+{
+    irq_state_t irq_state;
+
+    while (1)
+    {
+        runloop_dispatch ();
+
+        /* Mask interrupts while checking the queue so that an event
+           cannot be posted between the check and the WFI.  A pending
+           interrupt still wakes the CPU and is serviced once
+           interrupts are unmasked.  */
+        irq_state = irq_global_save ();
+        if (runloop_events_out == runloop_events_in)
+        {
+            runloop_stats.sleeps++;
+            cpu_wfi ();
+        }
+        irq_global_restore (irq_state);
+    }
+}
+
+
+void
+runloop_stats_get (runloop_stats_t *stats)
+{
+    irq_state_t irq_state;
+
+    irq_state = irq_global_save ();
+    *stats = runloop_stats;
+    irq_global_restore (irq_state);
+}
+
+
+void
+runloop_stats_reset (void)
+{
+    irq_state_t irq_state;
+
+    irq_state = irq_global_save ();
+    runloop_stats.events = 0;
+    runloop_stats.overruns = 0;
+    runloop_stats.sleeps = 0;
+    runloop_stats.latency_max = 0;
+    runloop_stats.latency_total = 0;
+    runloop_stats.depth_max = 0;
+    irq_global_restore (irq_state);
+}
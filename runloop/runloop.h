@@ -0,0 +1,104 @@
+/** @file   runloop.h
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Run to completion event loop.
+    @note   Interrupt handlers and timers post events to a bounded
+    queue.  The loop dispatches the event handlers in the order that
+    they were posted, calls the registered pollers, and sleeps when
+    there is nothing to do.  Handlers must not block.
+*/
+
+#ifndef RUNLOOP_H
+#define RUNLOOP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "config.h"
+#include "sysclock.h"
+
+
+typedef void (*runloop_handler_t) (void *arg, uint32_t data);
+
+typedef void (*runloop_poller_t) (void *arg);
+
+
+/** Timer that posts an event when it expires.  */
+typedef struct runloop_timer_struct
+{
+    sysclock_timer_t timer;
+    runloop_handler_t handler;
+    void *arg;
+} runloop_timer_t;
+
+
+typedef struct runloop_stats_struct
+{
+    /* Number of events dispatched.  */
+    uint32_t events;
+    /* Number of events lost due to the queue being full.  */
+    uint32_t overruns;
+    /* Number of times the loop has slept.  */
+    uint32_t sleeps;
+    /* Longest and total time in CPU clocks from posting an event to
+       calling its handler.  */
+    uint32_t latency_max;
+    uint64_t latency_total;
+    /* Largest number of queued events.  */
+    uint8_t depth_max;
+} runloop_stats_t;
+
+
+/** Post event.  This can be called from an interrupt handler.  Return
+    false if the queue is full.  */
+bool
+runloop_post (runloop_handler_t handler, void *arg, uint32_t data);
+
+
+/** Start timer that posts an event after delay_ms and then every
+    period_ms (if non-zero).  */
+void
+runloop_timer_start (runloop_timer_t *timer, uint32_t delay_ms,
+                     uint32_t period_ms, runloop_handler_t handler,
+                     void *arg);
+
+
+/** Stop timer.  An event that has been posted is still dispatched.  */
+void
+runloop_timer_stop (runloop_timer_t *timer);
+
+
+/** Register function called every iteration of the loop, say to poll
+    a driver such as udp_poll.  The loop iterates after every event
+    or interrupt.  Return false if there are too many pollers.  */
+bool
+runloop_poller_add (runloop_poller_t poller, void *arg);
+
+
+/** Dispatch the queued events and call the pollers.  Return true if
+    an event was dispatched.  */
+bool
+runloop_dispatch (void);
+
+
+/** Dispatch events forever, sleeping when the queue is empty.  */
+void
+runloop_run (void);
+
+
+/** Get statistics.  */
+void
+runloop_stats_get (runloop_stats_t *stats);
+
+
+/** Reset statistics.  */
+void
+runloop_stats_reset (void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
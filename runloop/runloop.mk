@@ -0,0 +1,8 @@
+RUNLOOP_DIR = $(MAT91LIB_DIR)/runloop
+
+VPATH += $(RUNLOOP_DIR)
+INCLUDES += -I$(RUNLOOP_DIR)
+
+SRC += runloop.c
+
+include $(MAT91LIB_DIR)/sysclock/sysclock.mk
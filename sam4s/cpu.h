@@ -40,6 +40,43 @@ cpu_wfi (void)
     __asm__ ("\twfi");
 }
 
+
+/** Wait for event.  This returns immediately if the event register is
+    set, otherwise it sleeps until an event, an interrupt, or (with
+    SEVONPEND) a disabled interrupt becoming pending.  */
+static inline void
+cpu_wfe (void)
+{
+    __asm__ volatile ("\twfe" : : : "memory");
+}
+
+
+/** Send event.  This wakes cores waiting in WFE and sets the event
+    register.  */
+static inline void
+cpu_sev (void)
+{
+    __asm__ volatile ("\tsev" : : : "memory");
+}
+
+
+/** Enable the DWT cycle counter.  This counts CPU clocks and wraps
+    every 2^32 clocks (about 36 s at 120 MHz).  */
+static inline void
+cpu_cycle_counter_enable (void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+/** Return the DWT cycle counter.  */
+static __always_inline__ uint32_t
+cpu_cycle_counter_get (void)
+{
+    return DWT->CYCCNT;
+}
+
 #ifdef __cplusplus
 }
 #endif    
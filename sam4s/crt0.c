@@ -9,6 +9,7 @@
 #include "sam4s.h"
 #include "mcu.h"
 #include "irq.h"
+#include "mcu_stack.h"
 
 /** Symbols defined by linker script.  These are all VMAs except those
     with a _load__ suffix which are LMAs.  */
@@ -21,6 +22,58 @@ extern char __bss_start__;      /** Start of uninitialised variables.  */
 extern char __bss_end__;        /** End of uninitialised variables.  */
 
 
+/* These are called before .data and .bss are initialised.  The loop
+   distribution optimisation is disabled since it would replace the
+   loops with calls to memcpy and memset; with newlib-nano these copy
+   a byte at a time.  */
+#define CRT0_NO_LIBCALLS __attribute__ ((optimize ("no-tree-loop-distribute-patterns")))
+
+
+/** Copy from src to dst until dst_end.  The linker script aligns
+    these to a word boundary.  Four words are copied per iteration so
+    that the compiler can use multiple load and store
+    instructions.  */
+static inline CRT0_NO_LIBCALLS void
+crt0_copy (uint32_t *dst, const uint32_t *src, const uint32_t *dst_end)
+{
+    while (dst + 4 <= dst_end)
+    {
+        uint32_t a = src[0];
+        uint32_t b = src[1];
+        uint32_t c = src[2];
+        uint32_t d = src[3];
+
+        dst[0] = a;
+        dst[1] = b;
+        dst[2] = c;
+        dst[3] = d;
+        dst += 4;
+        src += 4;
+    }
+
+    while (dst < dst_end)
+        *dst++ = *src++;
+}
+
+
+/** Zero from dst until dst_end.  */
+static inline CRT0_NO_LIBCALLS void
+crt0_zero (uint32_t *dst, const uint32_t *dst_end)
+{
+    while (dst + 4 <= dst_end)
+    {
+        dst[0] = 0;
+        dst[1] = 0;
+        dst[2] = 0;
+        dst[3] = 0;
+        dst += 4;
+    }
+
+    while (dst < dst_end)
+        *dst++ = 0;
+}
+
+
 int main (void);
 
 void __libc_init_array (void);
@@ -145,9 +198,6 @@ irq_handler_t exception_table[] =
 
 void _reset_handler (void)
 {
-    char *src;
-    char *dst;
-
     /* The stack pointer is automatically loaded with the first entry
        in the vector table on reset.  However, when debugging it is
        useful to jump to the reset address and have the stack pointer
@@ -159,6 +209,10 @@ void _reset_handler (void)
 
     SCB->VTOR = 0;
 
+#if MCU_BOOT_PROFILE
+    mcu_boot_profile_start ();
+#endif
+
     /* There's not much frigging around to set things up; the initial
        stack pointer is loaded from the vector table.  At this point
        we are running on the slow clock?  We could crank things up
@@ -168,12 +222,14 @@ void _reset_handler (void)
     /* Initialise initialised global variables in .data and relocate
        .ramtext function for functions in the ROM model that need
        to execute out of RAM for speed.  */
-    for (src = &__data_load__, dst = &__data_start__; dst < &__data_end__; )
-        *dst++ = *src++;
+    crt0_copy ((uint32_t *)&__data_start__, (uint32_t *)&__data_load__,
+               (uint32_t *)&__data_end__);
 
-    /* Zero uninitialised global variables in .bss.  */
-    for (dst = &__bss_start__; dst < &__bss_end__; )
-        *dst++ = 0;
+    /* Zero uninitialised global variables in .bss.  Variables in
+       .noinit are left alone.  */
+    crt0_zero ((uint32_t *)&__bss_start__, (uint32_t *)&__bss_end__);
+
+    BOOT_PROFILE_MARK ("crt0");
 
     /* Remap the exception table into SRAM to allow dynamic allocation.
        This register is zero on reset.  */
@@ -182,9 +238,16 @@ void _reset_handler (void)
     /* Set up clocks, etc.  */
     mcu_init ();
 
+#if MCU_STACK_PAINT
+    /* This is done at the full clock speed.  */
+    mcu_stack_paint ();
+#endif
+
     /* Call constructors and init functions.   */
     __libc_init_array ();
 
+    BOOT_PROFILE_MARK ("libc_init");
+
     main ();
 
     /* Hang.  */
@@ -13,6 +13,15 @@ extern "C" {
 
 #include "config.h"
 #include "bits.h"
+#include "cpu.h"
+
+
+/* Define IRQ_PROFILE as 1 in config.h to record the number of calls,
+   the duration, and the latency of every handler installed with
+   irq_vector_set or irq_config.  */
+#ifndef IRQ_PROFILE
+#define IRQ_PROFILE 0
+#endif
 
 typedef void (* irq_vector_t) (void);
 
@@ -31,6 +40,44 @@ extern irq_handler_t exception_table[];
 enum {IRQ_ID_MIN = 0, IRQ_ID_MAX = 31};
 
 
+/* Number of entries in exception table.  */
+#define IRQ_VECTORS_NUM (16 + PERIPH_COUNT_IRQn)
+
+
+#if IRQ_PROFILE
+typedef struct irq_profile_struct
+{
+    /* Number of times handler called.  */
+    uint32_t count;
+    /* Total CPU clocks spent in handler excluding nested handlers.  */
+    uint64_t total;
+    /* Maximum CPU clocks spent in handler excluding nested handlers.  */
+    uint32_t max;
+    /* Maximum CPU clocks from interrupt request to handler entry.
+       This is only known for SysTick and for interrupts triggered with
+       irq_trigger; otherwise it is zero.  */
+    uint32_t latency_max;
+} irq_profile_t;
+
+
+extern irq_handler_t irq_profile_handlers[];
+
+extern volatile uint32_t irq_profile_triggered[];
+
+
+/* Common handler that measures the handler for the active vector.  */
+void irq_profile_handler (void);
+
+
+/** Get profile for specified interrupt (or exception).  */
+bool irq_profile_get (irq_id_t id, irq_profile_t *profile);
+
+
+/** Reset profiles.  */
+void irq_profile_reset (void);
+#endif
+
+
 static inline void irq_type_set (irq_id_t id, irq_type_t type)
 {
     /* TODO.  */
@@ -40,48 +87,87 @@ static inline void irq_type_set (irq_id_t id, irq_type_t type)
 static inline void irq_priority_set (irq_id_t id, irq_priority_t priority)
 {
     // The smaller the number the higher the priority.
-    NVIC->IP[id] = priority << 4;
+    // The exception priorities are in the system handler priority
+    // registers.
+    if (id < 0)
+        SCB->SHP[(id & 0xf) - 4] = priority << 4;
+    else
+        NVIC->IP[id] = priority << 4;
 }
 
 
+/* The following functions do nothing for exceptions (negative ids)
+   since these are not controlled by the NVIC.  */
+
 static inline void irq_clear (irq_id_t id)
 {
+    if (id < 0)
+        return;
     NVIC->ICPR[id >> 5] = BIT (id & 0x1f);
 }
 
 
 static inline void irq_enable (irq_id_t id)
 {
+    if (id < 0)
+        return;
     NVIC->ISER[id >> 5] = BIT (id & 0x1f);
 }
 
 
 static inline bool irq_enabled_p (irq_id_t id)
 {
+    if (id < 0)
+        return 1;
     return (NVIC->ISER[id >> 5] & BIT (id & 0x1f)) != 0;
 }
 
 
 static inline void irq_disable (irq_id_t id)
 {
+    if (id < 0)
+        return;
     NVIC->ICER[id >> 5] = BIT (id & 0x1f);
 }
 
 
 static inline void irq_trigger (irq_id_t id)
 {
-    NVIC->ISPR[id >> 5] = BIT (id & 0x1f);
+#if IRQ_PROFILE
+    irq_profile_triggered[id + 16] = cpu_cycle_counter_get ();
+#endif
+    if (id == PendSV_IRQn)
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    else if (id >= 0)
+        NVIC->ISPR[id >> 5] = BIT (id & 0x1f);
 }
 
 
 /* Set up interrupt (or exception) handler.  */
 static inline void irq_vector_set (irq_id_t id, irq_vector_t isr)
 {
+#if IRQ_PROFILE
+    /* Install the common handler that calls the real handler.  */
+    irq_profile_handlers[id + 16] = isr;
+    exception_table[id + 16] = irq_profile_handler;
+#else
     exception_table[id + 16] = isr;
+#endif
     asm volatile ("" ::: "memory");
 }
 
 
+/* Return interrupt (or exception) handler.  */
+static inline irq_vector_t irq_vector_get (irq_id_t id)
+{
+#if IRQ_PROFILE
+    return irq_profile_handlers[id + 16];
+#else
+    return exception_table[id + 16];
+#endif
+}
+
+
 /* This sets up a vector for an IRQ interrupt.  Note that the IRQ
    vectors are stored in special memory-mapped registers and thus do
    not depend on RAM or ROM model.  */
@@ -127,6 +213,69 @@ void irq_global_enable (void)
     __asm__ ("\tcpsie i");
 }
 
+
+/* Critical sections.  These save the interrupt mask state on entry
+   and restore it on exit so that they can be nested.  Unlike
+   irq_global_disable and irq_global_enable, leaving an inner critical
+   section does not unmask interrupts for an enclosing one.
+
+   irq_critical_enter only masks the interrupts with the specified
+   priority or lower (a numerically equal or larger priority) using
+   BASEPRI; higher priority interrupts are still serviced.  Thus the
+   priority should be the highest priority of the handlers that share
+   the data being protected.  Since BASEPRI cannot mask priority 0,
+   this priority is treated as 1.
+
+   irq_global_save masks all the interrupts using PRIMASK.  */
+
+typedef uint32_t irq_state_t;
+
+
+/* Mask interrupts with the specified priority or lower, returning the
+   previous mask state.  The mask is never lowered so an inner
+   critical section with a lower priority has no effect.  */
+__inline __attribute__ ((always_inline))
+irq_state_t irq_critical_enter (irq_priority_t priority)
+{
+    irq_state_t state;
+
+    if (priority == 0)
+        priority = 1;
+
+    __asm__ volatile ("\tmrs %0, basepri" : "=r" (state));
+    __asm__ volatile ("\tmsr basepri_max, %0" : : "r" (priority << 4)
+                      : "memory");
+    return state;
+}
+
+
+/* Restore mask state saved by irq_critical_enter.  */
+__inline __attribute__ ((always_inline))
+void irq_critical_exit (irq_state_t state)
+{
+    __asm__ volatile ("\tmsr basepri, %0" : : "r" (state) : "memory");
+}
+
+
+/* Mask all interrupts, returning the previous mask state.  */
+__inline __attribute__ ((always_inline))
+irq_state_t irq_global_save (void)
+{
+    irq_state_t state;
+
+    __asm__ volatile ("\tmrs %0, primask" : "=r" (state));
+    __asm__ volatile ("\tcpsid i" : : : "memory");
+    return state;
+}
+
+
+/* Restore mask state saved by irq_global_save.  */
+__inline __attribute__ ((always_inline))
+void irq_global_restore (irq_state_t state)
+{
+    __asm__ volatile ("\tmsr primask, %0" : : "r" (state) : "memory");
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,123 @@
+/** @file   irq_profile.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Interrupt handler profiling.
+    @note   This is enabled by defining IRQ_PROFILE as 1 in config.h.
+    Each handler installed with irq_vector_set is called from a
+    common handler that measures it with the DWT cycle counter.
+*/
+
+#include "irq.h"
+
+#if IRQ_PROFILE
+
+/* The time spent in nested handlers is subtracted so that the
+   duration of a handler excludes the handlers that preempt it.  Each
+   handler adds its own (exclusive) time to irq_profile_nested, so the
+   increase seen by a handler is the total time of the handlers that
+   preempted it.
+
+   The latency is the time from the interrupt request to the entry of
+   the common handler.  This is only known when the request time is
+   known: for SysTick it is found from the counter value since the
+   request occurs when the counter reloads; for interrupts pended with
+   irq_trigger the request time is recorded.  For other peripheral
+   interrupts the request time is unknown and the latency is not
+   measured.  The overhead of the common handler, about 40 CPU clocks,
+   is included in the duration.  */
+
+
+irq_handler_t irq_profile_handlers[IRQ_VECTORS_NUM];
+
+volatile uint32_t irq_profile_triggered[IRQ_VECTORS_NUM];
+
+static irq_profile_t irq_profiles[IRQ_VECTORS_NUM];
+
+static volatile uint32_t irq_profile_nested;
+
+
+void
+irq_profile_handler (void)
+{
+    uint32_t start;
+    uint32_t nested;
+    uint32_t latency;
+    uint32_t duration;
+    uint32_t vector;
+    irq_profile_t *profile;
+    irq_state_t irq_state;
+
+    start = cpu_cycle_counter_get ();
+    nested = irq_profile_nested;
+
+    /* The active vector number is in the IPSR.  */
+    __asm__ volatile ("\tmrs %0, ipsr" : "=r" (vector));
+    vector &= 0x1ff;
+
+    latency = 0;
+    if (vector == SysTick_IRQn + 16)
+    {
+        /* This assumes that SysTick is clocked from the CPU clock.  */
+        latency = SysTick->LOAD - SysTick->VAL;
+    }
+    else if (irq_profile_triggered[vector])
+    {
+        latency = start - irq_profile_triggered[vector];
+        irq_profile_triggered[vector] = 0;
+    }
+
+    irq_profile_handlers[vector] ();
+
+    /* The update of irq_profile_nested must not be preempted.  */
+    irq_state = irq_global_save ();
+
+    duration = cpu_cycle_counter_get () - start
+        - (irq_profile_nested - nested);
+    irq_profile_nested += duration;
+
+    profile = &irq_profiles[vector];
+    profile->count++;
+    profile->total += duration;
+    if (duration > profile->max)
+        profile->max = duration;
+    if (latency > profile->latency_max)
+        profile->latency_max = latency;
+
+    irq_global_restore (irq_state);
+}
+
+
+bool
+irq_profile_get (irq_id_t id, irq_profile_t *profile)
+{
+    irq_state_t irq_state;
+
+    if (id + 16 < 0 || id + 16 >= IRQ_VECTORS_NUM)
+        return 0;
+
+    /* The total is 64 bits and cannot be read atomically.  */
+    irq_state = irq_global_save ();
+    *profile = irq_profiles[id + 16];
+    irq_global_restore (irq_state);
+    return 1;
+}
+
+
+void
+irq_profile_reset (void)
+{
+    irq_state_t irq_state;
+    unsigned int i;
+
+    irq_state = irq_global_save ();
+    for (i = 0; i < IRQ_VECTORS_NUM; i++)
+    {
+        irq_profiles[i].count = 0;
+        irq_profiles[i].total = 0;
+        irq_profiles[i].max = 0;
+        irq_profiles[i].latency_max = 0;
+    }
+    irq_global_restore (irq_state);
+}
+
+#endif
@@ -12,6 +12,18 @@
 
 #define MCU_FLASH_WAIT_STATES ((MCU_FLASH_READ_CYCLES) - 1)
 
+/* Flash read cycles required for MCK frequency F in Hz.  */
+#define MCU_FLASH_READ_CYCLES_NOMINAL(F) ((((F) / 1000000) + 20) / 21)
+
+/* Any extra read cycles configured by MCU_FLASH_READ_CYCLES, say for
+   a lower VDDIO, are applied at all operating points.  */
+#define MCU_FLASH_READ_CYCLES_EXTRA \
+    ((int)(MCU_FLASH_READ_CYCLES) \
+     - (int)MCU_FLASH_READ_CYCLES_NOMINAL ((uint32_t)F_CPU))
+
+/* Maximum MCK frequency for VDDCORE 1.2 V.  */
+#define F_MCK_MAX 120000000
+
 /* This must be in range 0--6.  The default is 1 giving a prescale
    value of 2.  */
 #ifndef MCU_MCK_PRESCALER_VALUE
@@ -79,6 +91,18 @@
 #endif
 
 
+/* Current MCK frequency.  */
+static uint32_t mcu_clock_frequency = F_CPU;
+
+static struct
+{
+    mcu_clock_notify_t notify;
+    void *arg;
+} mcu_clock_notifiers[MCU_CLOCK_NOTIFIERS_NUM];
+
+static uint8_t mcu_clock_notifiers_num = 0;
+
+
 /* Internal slow clock frequency.  */
 #define F_SLCK 32678
 
@@ -122,6 +146,20 @@ mcu_flash_init (void)
 }
 
 
+/** Return the flash wait states required for MCK frequency f_mck.  */
+static uint8_t
+mcu_flash_wait_states (uint32_t f_mck)
+{
+    int cycles;
+
+    cycles = MCU_FLASH_READ_CYCLES_NOMINAL (f_mck)
+        + MCU_FLASH_READ_CYCLES_EXTRA;
+    if (cycles < 1)
+        cycles = 1;
+    return cycles - 1;
+}
+
+
 void
 mcu_unique_id (mcu_unique_id_t id)
     __attribute__ ((section(".ramtext")));
@@ -217,6 +255,49 @@ mcu_mck_ready_wait (void)
 }
 
 
+/** Select MAINCK for MCK, reconfigure PLLA and the MCK prescaler, and
+    then select PLLA for MCK.  MAINCK must be running.  */
+static bool
+mcu_plla_mck_set (uint8_t plla_mul, uint8_t plla_div, uint8_t prescaler_value)
+{
+    /* The CSS and PRES fields cannot be changed at the same time.
+       When switching away from PLLA, CSS is changed first; when
+       switching to PLLA, PRES is changed first.  */
+    if ((PMC->PMC_MCKR & PMC_MCKR_CSS_Msk) != PMC_MCKR_CSS_MAIN_CLK)
+    {
+        PMC->PMC_MCKR = (PMC->PMC_MCKR & (~PMC_MCKR_CSS_Msk))
+            | PMC_MCKR_CSS_MAIN_CLK;
+        if (!mcu_mck_ready_wait ())
+            return 0;
+    }
+
+    /* Set prescaler.  */
+    PMC->PMC_MCKR = (PMC->PMC_MCKR & (~PMC_MCKR_PRES_Msk))
+        | (prescaler_value << PMC_MCKR_PRES_Pos);
+    if (!mcu_mck_ready_wait ())
+        return 0;
+
+    /* Disable PLLA if it is running and reset fields.  */
+    PMC->CKGR_PLLAR = CKGR_PLLAR_ONE | CKGR_PLLAR_MULA (0);
+
+    /* Configure and start PLLA.  The PLLA start delay is MCU_PLL_COUNT
+       SLCK cycles.  Note, PLLA (but not PLLB) needs the mysterious
+       bit CKGR_PLLAR_ONE set.  */
+    PMC->CKGR_PLLAR = CKGR_PLLAR_MULA (plla_mul - 1)
+        | CKGR_PLLAR_DIVA (plla_div)
+        | CKGR_PLLAR_PLLACOUNT (MCU_PLL_COUNT) | CKGR_PLLAR_ONE;
+
+    /* Wait for PLLA to start up.  */
+    while (! (PMC->PMC_SR & PMC_SR_LOCKA))
+        continue;
+
+    /* Switch to PLLA_CLCK for MCK.  */
+    PMC->PMC_MCKR = (PMC->PMC_MCKR & (~PMC_MCKR_CSS_Msk))
+        | PMC_MCKR_CSS_PLLA_CLK;
+    return mcu_mck_ready_wait ();
+}
+
+
 /** Set up the main clock (MAINCK), PLLA clock, and master clock (MCK).   */
 static int
 mcu_clock_init (void)
@@ -284,52 +365,143 @@ mcu_clock_init (void)
 
     /* TODO: disable RC oscillator if using XTAL oscillator.  */
 
-    /* Set prescaler.  */
-    PMC->PMC_MCKR = (PMC->PMC_MCKR & (~PMC_MCKR_PRES_Msk)) | (MCU_MCK_PRESCALER_VALUE << 4);
-
-    if (!mcu_mck_ready_wait ())
-        return 0;
-
     /* Could disable internal fast RC oscillator here if not being used.  */
 
-    /* Disable PLLA if it is running and reset fields.  */
-    PMC->CKGR_PLLAR = CKGR_PLLAR_ONE | CKGR_PLLAR_MULA (0);
-
-    /* Configure and start PLLA.  The PLLA start delay is MCU_PLL_COUNT
-       SLCK cycles.  Note, PLLA (but not PLLB) needs the mysterious
-       bit CKGR_PLLAR_ONE set.  */
-    PMC->CKGR_PLLAR = CKGR_PLLAR_MULA (MCU_PLLA_MUL - 1)
-        | CKGR_PLLAR_DIVA (MCU_PLLA_DIV)
-        | CKGR_PLLAR_PLLACOUNT (MCU_PLL_COUNT) | CKGR_PLLAR_ONE;
-
     #ifdef MCU_PLLB_MUL
     /* Configure and start PLLB.  The PLLB start delay is MCU_PLLB_COUNT
        SLCK cycles.  */
     PMC->CKGR_PLLBR = CKGR_PLLBR_MULB (MCU_PLLB_MUL - 1)
         | CKGR_PLLBR_DIVB (MCU_PLLB_DIV)
         | CKGR_PLLBR_PLLBCOUNT (MCU_PLL_COUNT);
-    #endif
 
-    /* Wait for PLLA to start up.  */
-    while (! (PMC->PMC_SR & PMC_SR_LOCKA))
-        continue;
-
-    #ifdef MCU_PLLB_MUL
     /* Wait for PLLB to start up.  */
     while (! (PMC->PMC_SR & PMC_SR_LOCKB))
         continue;
     #endif
 
-    /* Switch to PLLA_CLCK for MCK.  */
-    PMC->PMC_MCKR = (PMC->PMC_MCKR & (~PMC_MCKR_CSS_Msk))
-        | PMC_MCKR_CSS_PLLA_CLK;
-    if (!mcu_mck_ready_wait ())
+    /* The clock may have been lowered by mcu_clock_set.  */
+    mcu_flash_wait_states_set (MCU_FLASH_WAIT_STATES);
+
+    if (!mcu_plla_mck_set (MCU_PLLA_MUL, MCU_PLLA_DIV,
+                           MCU_MCK_PRESCALER_VALUE))
         return 0;
 
+    mcu_clock_frequency = F_CPU;
     return 1;
 }
 
 
+uint32_t
+mcu_clock_get (void)
+{
+    return mcu_clock_frequency;
+}
+
+
+/** Return the current PLLA output frequency.  */
+static uint32_t
+mcu_plla_frequency (void)
+{
+    uint32_t pllar;
+    uint32_t div;
+
+    pllar = PMC->CKGR_PLLAR;
+    div = (pllar & CKGR_PLLAR_DIVA_Msk) >> CKGR_PLLAR_DIVA_Pos;
+    if (!div)
+        return 0;
+    return (uint32_t)F_XTAL / div
+        * (((pllar & CKGR_PLLAR_MULA_Msk) >> CKGR_PLLAR_MULA_Pos) + 1);
+}
+
+
+bool
+mcu_clock_notify_register (mcu_clock_notify_t notify, void *arg)
+{
+    unsigned int i;
+
+    for (i = 0; i < mcu_clock_notifiers_num; i++)
+    {
+        if (mcu_clock_notifiers[i].notify == notify
+            && mcu_clock_notifiers[i].arg == arg)
+            return 1;
+    }
+
+    if (mcu_clock_notifiers_num >= MCU_CLOCK_NOTIFIERS_NUM)
+        return 0;
+
+    mcu_clock_notifiers[mcu_clock_notifiers_num].notify = notify;
+    mcu_clock_notifiers[mcu_clock_notifiers_num].arg = arg;
+    mcu_clock_notifiers_num++;
+    return 1;
+}
+
+
+static void
+mcu_clock_notify (mcu_clock_event_t event, uint32_t f_mck)
+{
+    unsigned int i;
+
+    for (i = 0; i < mcu_clock_notifiers_num; i++)
+        mcu_clock_notifiers[i].notify (mcu_clock_notifiers[i].arg,
+                                       event, f_mck);
+}
+
+
+uint32_t
+mcu_clock_set (const mcu_clock_cfg_t *cfg)
+{
+    uint32_t f_plla_in;
+    uint32_t f_plla;
+    uint32_t f_mck;
+    uint32_t f_mck_old;
+    bool ok;
+
+    if (cfg->plla_mul < 1 || cfg->plla_mul > 62 || cfg->plla_div < 1
+        || cfg->prescaler_value > 6)
+        return 0;
+
+    f_plla_in = (uint32_t)F_XTAL / cfg->plla_div;
+    f_plla = f_plla_in * cfg->plla_mul;
+    if (f_plla_in < F_PLLA_IN_MIN || f_plla_in > F_PLLA_IN_MAX
+        || f_plla < F_PLLA_OUT_MIN || f_plla > F_PLLA_OUT_MAX)
+        return 0;
+
+    f_mck = f_plla >> cfg->prescaler_value;
+    if (f_mck > F_MCK_MAX)
+        return 0;
+
+    /* Changing PLLA would upset the USB clock if derived from it.  */
+    if ((PMC->PMC_SCSR & PMC_SCSR_UDP) && ! (PMC->PMC_USB & PMC_USB_USBS)
+        && f_plla != mcu_plla_frequency ())
+        return 0;
+
+    f_mck_old = mcu_clock_frequency;
+
+    mcu_clock_notify (MCU_CLOCK_CHANGE_PRE, f_mck);
+
+    /* The flash must be slowed down before the clock is sped up.  */
+    if (f_mck > f_mck_old)
+        mcu_flash_wait_states_set (mcu_flash_wait_states (f_mck));
+
+    ok = mcu_plla_mck_set (cfg->plla_mul, cfg->plla_div,
+                           cfg->prescaler_value);
+
+    if (ok)
+    {
+        mcu_clock_frequency = f_mck;
+        if (f_mck < f_mck_old)
+            mcu_flash_wait_states_set (mcu_flash_wait_states (f_mck));
+    }
+
+    /* The delay loop time depends on the wait states and MCK.  */
+    mcu_delay_calibrate ();
+
+    mcu_clock_notify (MCU_CLOCK_CHANGE_POST, mcu_clock_frequency);
+
+    return ok ? f_mck : 0;
+}
+
+
 extern void _irq_unexpected_handler (void);
 
 extern void _irq_spurious_handler (void);
@@ -397,6 +569,21 @@ mcu_init (void)
 
     mcu_clock_init ();
 
+    BOOT_PROFILE_MARK ("clock_init");
+
+    /* This is used for timestamps and profiling.  */
+    cpu_cycle_counter_enable ();
+
+    /* This depends on the flash wait states so must be performed
+       after the clock is set up.  */
+    mcu_delay_calibrate ();
+
+    BOOT_PROFILE_MARK ("mcu_init");
+
+    /* Allow a disabled interrupt becoming pending to wake the core
+       from WFE.  This is used by MCU_WAIT_UNTIL.  */
+    SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
+
 #if 0
     /* Enable protect mode.  */
     AIC->AIC_DCR |= AIC_DCR_PROT;
@@ -458,18 +645,102 @@ mcu_power_mode_normal (void)
 }
 
 
-void mcu_cpu_idle (void)
+/* Start with the expected value in case a delay is used before
+   calibration.  */
+uint32_t mcu_delay_loop_scale = (1 << 16) / MCU_FLASH_READ_CYCLES;
+
+
+#define MCU_DELAY_CALIBRATE_LOOPS 1000
+
+
+void
+mcu_delay_calibrate (void)
 {
-#if 0
-    /* TODO.  */
+    uint32_t start;
+    uint32_t cycles;
+    irq_state_t irq_state;
+
+    /* The measurement must not be disturbed by interrupts.  */
+    irq_state = irq_global_save ();
 
-    /* Turn off CPU clock after current instruction.  It will be
-       re-enabled when an interrupt occurs.  */
-    PMC->PMC_SCDR = PMC_PCK;
+    start = cpu_cycle_counter_get ();
+    mcu_delay_loop (MCU_DELAY_CALIBRATE_LOOPS);
+    cycles = cpu_cycle_counter_get () - start;
 
-    while ((PMC->PMC_SCSR & PMC_PCK) != PMC_PCK)
+    irq_global_restore (irq_state);
+
+    /* The loop runs one more iteration than requested.  The delay
+       macros count F_CPU clocks so the scale is adjusted for the
+       current MCK frequency.  */
+    mcu_delay_loop_scale = ((uint64_t)(MCU_DELAY_CALIBRATE_LOOPS + 1) << 16)
+        * mcu_clock_frequency / ((uint64_t)cycles * (uint32_t)F_CPU);
+}
+
+
+__attribute__ ((section (".ramtext"), noinline))
+void
+mcu_delay_cycles (uint32_t cycles)
+{
+    uint32_t start;
+
+    start = cpu_cycle_counter_get ();
+    while (cpu_cycle_counter_get () - start < cycles)
         continue;
-#endif
+}
+
+
+/* Number of references to each peripheral clock.  */
+static uint8_t mcu_pmc_refs[MCU_PMC_ID_NUM];
+
+
+void
+mcu_pmc_acquire (uint8_t id)
+{
+    irq_state_t irq_state;
+
+    if (id >= MCU_PMC_ID_NUM)
+        return;
+
+    /* This may be called from interrupt handlers.  */
+    irq_state = irq_global_save ();
+    if (mcu_pmc_refs[id]++ == 0)
+        mcu_pmc_enable (id);
+    irq_global_restore (irq_state);
+}
+
+
+void
+mcu_pmc_release (uint8_t id)
+{
+    irq_state_t irq_state;
+
+    if (id >= MCU_PMC_ID_NUM)
+        return;
+
+    irq_state = irq_global_save ();
+    if (mcu_pmc_refs[id] && --mcu_pmc_refs[id] == 0)
+        mcu_pmc_disable (id);
+    irq_global_restore (irq_state);
+}
+
+
+uint8_t
+mcu_pmc_refs_get (uint8_t id)
+{
+    if (id >= MCU_PMC_ID_NUM)
+        return 0;
+    return mcu_pmc_refs[id];
+}
+
+
+/* Stop the CPU clock until an interrupt occurs.  The peripheral
+   clocks keep running.  If interrupts are masked with PRIMASK, the
+   CPU wakes when an interrupt becomes pending but the handler is not
+   called until interrupts are unmasked.  */
+void mcu_cpu_idle (void)
+{
+    __DSB ();
+    cpu_wfi ();
 }
 
 
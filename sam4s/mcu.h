@@ -13,6 +13,8 @@ extern "C" {
 
 #include "config.h"
 #include "stdint.h"
+#include "cpu.h"
+#include "irq.h"
 
 typedef uint32_t mcu_unique_id_t[4];
 
@@ -24,6 +26,90 @@ typedef uint32_t mcu_unique_id_t[4];
 #endif
 
 
+/* Define MCU_IDLE_WAIT as 1 in config.h for the blocking driver
+   functions to sleep while waiting for a peripheral.  */
+#ifndef MCU_IDLE_WAIT
+#define MCU_IDLE_WAIT 0
+#endif
+
+
+/* Wait until COND is true.  With MCU_IDLE_WAIT, the core sleeps until
+   the interrupt ID becomes pending.  The peripheral interrupt for the
+   condition must be enabled in the peripheral but need not be enabled
+   in the NVIC.  The pending interrupt is cleared before the condition
+   is checked so that the next change wakes the core; the peripheral
+   interrupts are level sensitive so this does not lose a condition
+   that is still true.  */
+#if MCU_IDLE_WAIT
+#define MCU_WAIT_UNTIL(COND, ID)                \
+    do                                          \
+    {                                           \
+        irq_clear (ID);                         \
+        if (COND)                               \
+            break;                              \
+        cpu_wfe ();                             \
+    } while (1)
+#else
+#define MCU_WAIT_UNTIL(COND, ID)                \
+    do                                          \
+    {                                           \
+    } while (!(COND))
+#endif
+
+
+/* Define MCU_BOOT_PROFILE as 1 in config.h to record the cycle
+   counter at fixed points during startup (in crt0 and mcu_init) and
+   at the BOOT_PROFILE_MARK markers in driver init functions.  */
+#ifndef MCU_BOOT_PROFILE
+#define MCU_BOOT_PROFILE 0
+#endif
+
+#ifndef MCU_BOOT_PROFILE_RECORDS
+#define MCU_BOOT_PROFILE_RECORDS 32
+#endif
+
+
+/** Boot profile record.  */
+typedef struct mcu_boot_profile_struct
+{
+    const char *name;
+    /* Cycle counter value.  */
+    uint32_t cycles;
+    /* CPU clock frequency when the mark was made.  */
+    uint32_t f_cpu;
+} mcu_boot_profile_t;
+
+
+#if MCU_BOOT_PROFILE
+#define BOOT_PROFILE_MARK(NAME) mcu_boot_profile_mark (NAME)
+#else
+#define BOOT_PROFILE_MARK(NAME)
+#endif
+
+
+/** Start the boot profile.  This is called by the reset handler
+    before .data and .bss are initialised.  */
+void
+mcu_boot_profile_start (void);
+
+
+/** Record the cycle counter with a name.  This is ignored once the
+    records are full.  */
+void
+mcu_boot_profile_mark (const char *name);
+
+
+/** Set *records to the boot profile records and return the number of
+    records.  */
+unsigned int
+mcu_boot_profile_get (const mcu_boot_profile_t **records);
+
+
+/** Print the boot profile with the time between marks.  */
+void
+mcu_boot_profile_print (void);
+
+
 #ifndef MCU_FLASH_READ_CYCLES
 /* 5 cycles for 96 MHz, 6 cycles for 120 MHz for 2.7 < VDDIO < 3.6
    and VDDCORE 1.2 V.   Need extra read cycle for lower VDDIO.  */
@@ -42,10 +128,102 @@ mcu_delay_loop (unsigned int loops)
 }
 
 
+/* Number of mcu_delay_loop iterations per F_CPU clock period scaled
+   by 2^16.  This is measured by mcu_init and mcu_clock_set since the
+   loop time depends on the flash wait states, prefetch, and the
+   current MCK frequency.  */
+extern uint32_t mcu_delay_loop_scale;
+
+
+/** Measure the mcu_delay_loop iteration time.  This is called by
+    mcu_init.  */
+void
+mcu_delay_calibrate (void);
+
+
+/** Delay for the specified number of CPU clocks using the cycle
+    counter.  This runs from SRAM so that it is not affected by the
+    flash wait states; the delay is accurate to within a few clocks
+    plus the call overhead.  */
+void
+mcu_delay_cycles (uint32_t cycles) __attribute__ ((long_call));
+
+
 void
 mcu_init (void);
 
 
+/** Clock operating point.  The MCK frequency is given by
+    F_XTAL * plla_mul / plla_div / 2^prescaler_value.  The PLLA output
+    frequency must be between 80 and 240 MHz.  */
+typedef struct mcu_clock_cfg_struct
+{
+    /* PLLA multiplier, 1--62.  */
+    uint8_t plla_mul;
+    /* PLLA divider, 1--255.  */
+    uint8_t plla_div;
+    /* MCK prescaler value, 0--6 for a prescale of 1 to 64.  */
+    uint8_t prescaler_value;
+} mcu_clock_cfg_t;
+
+
+typedef enum
+{
+    /* MCK is about to change; quiesce transfers using the old clock.  */
+    MCU_CLOCK_CHANGE_PRE,
+    /* MCK has changed; recompute clock divisors.  */
+    MCU_CLOCK_CHANGE_POST
+} mcu_clock_event_t;
+
+
+/** Clock change notifier.  This is called with the new MCK frequency
+    for both events.  It is called from the context of mcu_clock_set
+    and not from an interrupt.  */
+typedef void (*mcu_clock_notify_t) (void *arg, mcu_clock_event_t event,
+                                    uint32_t f_mck);
+
+
+/* Number of clock notifiers reserved for the application.  */
+#ifndef MCU_CLOCK_NOTIFIERS_USER
+#define MCU_CLOCK_NOTIFIERS_USER 4
+#endif
+
+
+/* Each driver instance that follows MCK registers one notifier: three
+   TC channels, two UARTs, two USARTs, two TWIs, SPI, tick, and
+   sysclock.  */
+#ifndef MCU_CLOCK_NOTIFIERS_NUM
+#define MCU_CLOCK_NOTIFIERS_NUM (3 + 2 + 2 + 2 + 1 + 1 + 1 \
+                                 + MCU_CLOCK_NOTIFIERS_USER)
+#endif
+
+
+/** Return the current MCK (and CPU clock) frequency in Hz.  This is
+    F_CPU unless changed by mcu_clock_set.  */
+uint32_t
+mcu_clock_get (void);
+
+
+/** Switch MCK to a new operating point.  The flash wait states are
+    increased before speeding up and decreased after slowing down.
+    The registered notifiers are called before and after the change
+    and the delay loop is recalibrated.  This returns the new MCK
+    frequency or zero if the operating point is invalid, or if the
+    USB clock is derived from PLLA and is running and the PLLA
+    frequency would change.  Note, sysclock and the SysTick based
+    timers count CPU clocks so their periods scale with MCK.  */
+uint32_t
+mcu_clock_set (const mcu_clock_cfg_t *cfg);
+
+
+/** Register a function to be called when MCK changes.  Return false
+    if there are no free slots; the driver init functions then fail.
+    Registering the same function and argument again has no
+    effect.  */
+bool
+mcu_clock_notify_register (mcu_clock_notify_t notify, void *arg);
+
+
 void
 mcu_select_slowclock (void);
 
@@ -106,6 +284,28 @@ mcu_pmc_disable (uint8_t id)
 }
 
 
+/* Number of peripheral clock identifiers.  */
+#define MCU_PMC_ID_NUM 64
+
+
+/** Acquire a reference to the peripheral clock for ID.  The clock is
+    enabled for the first reference.  Each call must be balanced by a
+    call to mcu_pmc_release.  */
+void
+mcu_pmc_acquire (uint8_t id);
+
+
+/** Release a reference to the peripheral clock for ID.  The clock is
+    disabled when the last reference is released.  */
+void
+mcu_pmc_release (uint8_t id);
+
+
+/** Return the number of references to the peripheral clock for ID.  */
+uint8_t
+mcu_pmc_refs_get (uint8_t id);
+
+
 void
 mcu_cpu_idle (void);
 
@@ -0,0 +1,94 @@
+/** @file   mcu_boot_profile.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Boot time profiling for SAM4S processors.
+    @note   This is enabled by defining MCU_BOOT_PROFILE as 1 in config.h.
+*/
+
+#include "config.h"
+#include "mcu.h"
+#include "cpu.h"
+
+#if MCU_BOOT_PROFILE
+
+/* The cycle counter is enabled at reset so the stages before the
+   clock is switched to PLLA are counted at the 4 MHz fast RC
+   oscillator frequency.  The time for each stage is calculated using
+   the CPU clock frequency at the start of the stage.
+
+   The records are stored in .noinit since profiling starts before
+   .bss is zeroed.  They survive a software reset but are
+   overwritten by the next boot.  */
+
+#define MCU_BOOT_PROFILE_F_RESET 4000000
+
+__noinit__ static mcu_boot_profile_t mcu_boot_profiles[MCU_BOOT_PROFILE_RECORDS];
+
+__noinit__ static unsigned int mcu_boot_profiles_num;
+
+
+void
+mcu_boot_profile_start (void)
+{
+    cpu_cycle_counter_enable ();
+
+    mcu_boot_profiles_num = 0;
+    mcu_boot_profile_mark ("reset");
+}
+
+
+void
+mcu_boot_profile_mark (const char *name)
+{
+    mcu_boot_profile_t *record;
+    uint32_t cycles;
+
+    cycles = cpu_cycle_counter_get ();
+
+    if (mcu_boot_profiles_num >= MCU_BOOT_PROFILE_RECORDS)
+        return;
+
+    record = &mcu_boot_profiles[mcu_boot_profiles_num];
+    record->name = name;
+    record->cycles = cycles;
+    /* MCK is only driven by PLLA once mcu_clock_get is valid.  */
+    record->f_cpu = MCU_BOOT_PROFILE_F_RESET;
+    if ((PMC->PMC_MCKR & PMC_MCKR_CSS_Msk) == PMC_MCKR_CSS_PLLA_CLK)
+        record->f_cpu = mcu_clock_get ();
+    mcu_boot_profiles_num++;
+}
+
+
+unsigned int
+mcu_boot_profile_get (const mcu_boot_profile_t **records)
+{
+    *records = mcu_boot_profiles;
+    return mcu_boot_profiles_num;
+}
+
+
+void
+mcu_boot_profile_print (void)
+{
+    unsigned int i;
+    uint32_t total_us;
+
+    total_us = 0;
+    for (i = 1; i < mcu_boot_profiles_num; i++)
+    {
+        const mcu_boot_profile_t *prev = &mcu_boot_profiles[i - 1];
+        const mcu_boot_profile_t *record = &mcu_boot_profiles[i];
+        uint32_t cycles;
+        uint32_t us;
+
+        cycles = record->cycles - prev->cycles;
+        us = (uint64_t)cycles * 1000000 / prev->f_cpu;
+        total_us += us;
+
+        printf ("%-16s %10lu cycles %8lu us %8lu us\n", record->name,
+                (unsigned long)cycles, (unsigned long)us,
+                (unsigned long)total_us);
+    }
+}
+
+#endif
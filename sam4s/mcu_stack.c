@@ -0,0 +1,77 @@
+/** @file   mcu_stack.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Stack usage measurement for SAM4S processors.
+*/
+
+#include "mcu_stack.h"
+#include "sys.h"
+
+/* The stack grows down from __stack_start__ towards the heap, which
+   grows up from end.  The region between the heap and the stack
+   pointer is painted.  The deepest stack use is found by scanning up
+   from the end of the heap for the first overwritten word.  A stack
+   frame that is allocated but not written is not detected; this is
+   only likely for large local arrays.  */
+
+/* Space below the stack pointer to leave unpainted for the frame of
+   the paint loop.  */
+#define MCU_STACK_PAINT_MARGIN 64
+
+
+extern char __stack_start__;
+
+
+static uint32_t *
+mcu_stack_bottom (void)
+{
+    uintptr_t addr;
+
+    /* Round up to a word boundary.  */
+    addr = ((uintptr_t)sys_heap_end_get () + 3) & ~3u;
+    return (uint32_t *)addr;
+}
+
+
+void
+mcu_stack_paint (void)
+{
+    register char *stack_ptr __asm ("sp");
+    uint32_t *dst;
+    uint32_t *top;
+
+    top = (uint32_t *)(((uintptr_t)stack_ptr - MCU_STACK_PAINT_MARGIN) & ~3u);
+
+    for (dst = mcu_stack_bottom (); dst < top; dst++)
+        *dst = MCU_STACK_PAINT_PATTERN;
+}
+
+
+uint32_t
+mcu_stack_size_get (void)
+{
+    return &__stack_start__ - (char *)mcu_stack_bottom ();
+}
+
+
+uint32_t
+mcu_stack_headroom_get (void)
+{
+    uint32_t *p;
+    uint32_t *top;
+
+    top = (uint32_t *)&__stack_start__;
+    for (p = mcu_stack_bottom (); p < top; p++)
+    {
+        if (*p != MCU_STACK_PAINT_PATTERN)
+            break;
+    }
+    return (char *)p - (char *)mcu_stack_bottom ();
+}
+
+
+uint32_t
+mcu_stack_high_water_get (void)
+{
+    return mcu_stack_size_get () - mcu_stack_headroom_get ();
+}
@@ -0,0 +1,59 @@
+/** @file   mcu_stack.h
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Stack usage measurement for SAM4S processors.
+    @note   The main program and the interrupt handlers share the stack
+    (MSP) at the top of SRAM, so the high water mark includes the
+    deepest nesting of interrupts seen.
+*/
+#ifndef MCU_STACK_H
+#define MCU_STACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "config.h"
+
+
+/* Define MCU_STACK_PAINT as 1 in config.h to paint the stack at
+   startup.  This is required for the high water mark and headroom
+   measurements but slows the startup.  */
+#ifndef MCU_STACK_PAINT
+#define MCU_STACK_PAINT 0
+#endif
+
+#define MCU_STACK_PAINT_PATTERN 0xc5c5c5c5
+
+
+/** Fill the unused stack with a pattern.  If MCU_STACK_PAINT is
+    non-zero, this is called by the reset handler after mcu_init, so
+    it runs at the full clock speed.  */
+void
+mcu_stack_paint (void);
+
+
+/** Return the number of bytes between the end of the heap and the
+    top of the stack.  */
+uint32_t
+mcu_stack_size_get (void);
+
+
+/** Return the deepest stack use in bytes since the stack was
+    painted.  This scans the painted region so takes a while for a
+    large stack.  */
+uint32_t
+mcu_stack_high_water_get (void);
+
+
+/** Return the number of bytes between the end of the heap and the
+    deepest stack use.  */
+uint32_t
+mcu_stack_headroom_get (void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* MCU_STACK_H  */
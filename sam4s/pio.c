@@ -1,2 +1,204 @@
-/* Nothing to do.  All the functions are inline and defined in pio.h  */
+/** @file   pio.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  PIO interrupt dispatch for SAM4S microcontroller.
+    @note   Most of the PIO functions are inline and defined in pio.h
+*/
 
+#include "pio.h"
+#include "irq.h"
+
+
+/* Each PIO controller has a single interrupt and reading PIO_ISR
+   clears all the pending input change interrupts for the port.  Thus
+   there is a common handler for each port that reads PIO_ISR once and
+   delegates to the handlers registered for each PIO.  */
+
+
+/* Maximum number of PIOs with registered interrupt handlers.  */
+#ifndef PIO_IRQ_HANDLERS_NUM
+#define PIO_IRQ_HANDLERS_NUM 8
+#endif
+
+
+typedef struct pio_irq_dev_struct
+{
+    pio_t pio;
+    pio_irq_handler_t handler;
+    void *arg;
+} pio_irq_dev_t;
+
+
+static pio_irq_dev_t pio_irq_devs[PIO_IRQ_HANDLERS_NUM];
+static uint8_t pio_irq_devs_num = 0;
+
+/* Bitmask of the ports holding a peripheral clock reference.  */
+static uint8_t pio_clock_ports = 0;
+
+
+void
+pio_init (pio_t pio)
+{
+    irq_state_t irq_state;
+
+    irq_state = irq_global_save ();
+    if (!(pio_clock_ports & BIT (PIO_PORT (pio))))
+    {
+        pio_clock_ports |= BIT (PIO_PORT (pio));
+        mcu_pmc_acquire (PIO_ID (pio));
+    }
+    irq_global_restore (irq_state);
+}
+
+
+void
+pio_shutdown (pio_t pio)
+{
+    irq_state_t irq_state;
+
+    irq_state = irq_global_save ();
+    if (pio_clock_ports & BIT (PIO_PORT (pio)))
+    {
+        pio_clock_ports &= ~BIT (PIO_PORT (pio));
+        mcu_pmc_release (PIO_ID (pio));
+    }
+    irq_global_restore (irq_state);
+}
+
+
+static void
+pio_irq_dispatch (Pio *base, unsigned int port)
+{
+    uint32_t status;
+    unsigned int i;
+
+    /* This clears the interrupts for the port.  */
+    status = base->PIO_ISR & base->PIO_IMR;
+
+    for (i = 0; status && i < pio_irq_devs_num; i++)
+    {
+        pio_irq_dev_t *dev = &pio_irq_devs[i];
+
+        if (!dev->handler || PIO_PORT (dev->pio) != port)
+            continue;
+
+        if (status & PIO_BITMASK_ (dev->pio))
+        {
+            status &= ~PIO_BITMASK_ (dev->pio);
+            dev->handler (dev->arg, dev->pio);
+        }
+    }
+}
+
+
+static void
+pio_irq_handlerA (void)
+{
+    pio_irq_dispatch (PIOA, PORT_A);
+}
+
+
+static void
+pio_irq_handlerB (void)
+{
+    pio_irq_dispatch (PIOB, PORT_B);
+}
+
+
+#ifdef ID_PIOC
+static void
+pio_irq_handlerC (void)
+{
+    pio_irq_dispatch (PIOC, PORT_C);
+}
+#endif
+
+
+bool
+pio_irq_handler_set (pio_t pio, irq_priority_t priority,
+                     pio_irq_handler_t handler, void *arg)
+{
+    pio_irq_dev_t *dev = 0;
+    irq_vector_t isr;
+    unsigned int i;
+
+    /* Reuse the entry for this PIO, otherwise a free entry.  */
+    for (i = 0; i < pio_irq_devs_num; i++)
+    {
+        if (pio_irq_devs[i].pio == pio)
+        {
+            dev = &pio_irq_devs[i];
+            break;
+        }
+        if (!dev && !pio_irq_devs[i].handler)
+            dev = &pio_irq_devs[i];
+    }
+
+    if (!dev)
+    {
+        if (pio_irq_devs_num >= PIO_IRQ_HANDLERS_NUM)
+            return 0;
+        dev = &pio_irq_devs[pio_irq_devs_num];
+    }
+
+    switch (PIO_PORT (pio))
+    {
+    case PORT_A:
+        isr = pio_irq_handlerA;
+        break;
+
+    case PORT_B:
+        isr = pio_irq_handlerB;
+        break;
+
+#ifdef ID_PIOC
+    case PORT_C:
+        isr = pio_irq_handlerC;
+        break;
+#endif
+
+    default:
+        return 0;
+    }
+
+    /* Disable the port interrupt while the table is modified.  */
+    irq_disable (PIO_ID (pio));
+
+    dev->pio = pio;
+    dev->arg = arg;
+    dev->handler = handler;
+    if (dev == &pio_irq_devs[pio_irq_devs_num])
+        pio_irq_devs_num++;
+
+    /* The PIO controller clock is required for input change
+       detection.  */
+    pio_init (pio);
+
+    if (irq_vector_get (PIO_ID (pio)) != isr)
+        irq_config (PIO_ID (pio), priority, isr);
+    else
+        irq_priority_set (PIO_ID (pio), priority);
+
+    irq_enable (PIO_ID (pio));
+    return 1;
+}
+
+
+void
+pio_irq_handler_clear (pio_t pio)
+{
+    unsigned int i;
+
+    pio_irq_disable (pio);
+
+    for (i = 0; i < pio_irq_devs_num; i++)
+    {
+        if (pio_irq_devs[i].pio == pio)
+            pio_irq_devs[i].handler = 0;
+    }
+
+    /* Release the free entries at the end of the table.  The others
+       are reused by pio_irq_handler_set.  */
+    while (pio_irq_devs_num && !pio_irq_devs[pio_irq_devs_num - 1].handler)
+        pio_irq_devs_num--;
+}
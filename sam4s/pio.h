@@ -15,6 +15,7 @@ extern "C" {
 
 #include "config.h"
 #include "mcu.h"
+#include "irq.h"
 
 
 #define PIO_SAM4S
@@ -221,20 +222,16 @@ typedef uint32_t pio_t;
 
 
 /** Enable the clock for the port.  This is required for input
-    operations.  */
-static inline void
-pio_init (pio_t pio)
-{
-    mcu_pmc_enable (PIO_ID (pio));
-}
+    operations.  The port holds a single reference to its peripheral
+    clock so this can be called for each input PIO.  */
+void
+pio_init (pio_t pio);
 
 
-/** Disable the clock for the port.  */
-static inline void
-pio_shutdown (pio_t pio)
-{
-    mcu_pmc_disable (PIO_ID (pio));
-}
+/** Release the port reference to its peripheral clock.  The clock is
+    disabled if no other driver holds a reference.  */
+void
+pio_shutdown (pio_t pio);
 
 
 /** Configure PIO
@@ -377,14 +374,6 @@ pio_output_toggle (pio_t pio)
 }
 
 
-void
-pio_init (pio_t pio);
-
-
-void
-pio_shutdown (pio_t pio);
-
-
 typedef enum pio_irq_config_enum 
 {
     PIO_IRQ_FALLING_EDGE = 1, 
@@ -475,6 +464,73 @@ pio_irq_clear (pio_t pio)
 }
 
 
+typedef void (*pio_irq_handler_t) (void *arg, pio_t pio);
+
+
+/** Register handler for input change interrupt for specified PIO.
+    This uses a common interrupt handler for each port that reads
+    PIO_ISR once and delegates to the registered handlers; this
+    avoids one handler clearing the interrupts of another.  The
+    priority applies to the whole port.  Note, the interrupt still
+    needs to be enabled with pio_irq_enable.  */
+bool
+pio_irq_handler_set (pio_t pio, irq_priority_t priority,
+                     pio_irq_handler_t handler, void *arg);
+
+
+/** Unregister handler for specified PIO.  */
+void
+pio_irq_handler_clear (pio_t pio);
+
+
+/** Enable glitch filter for specified PIO.  This rejects pulses
+    shorter than half a MCK period.  */
+static __always_inline__ void
+pio_glitch_filter_enable (pio_t pio)
+{
+    PIO_BASE (pio)->PIO_IFSCDR = PIO_BITMASK_ (pio);
+    PIO_BASE (pio)->PIO_IFER = PIO_BITMASK_ (pio);
+}
+
+
+/** Enable debounce filter for specified PIO.  This rejects pulses
+    shorter than half the debounce period and passes pulses longer
+    than the debounce period.  The debounce period is shared by all
+    the PIOs on the same port; see pio_debounce_divider_set.  */
+static __always_inline__ void
+pio_debounce_filter_enable (pio_t pio)
+{
+    PIO_BASE (pio)->PIO_IFSCER = PIO_BITMASK_ (pio);
+    PIO_BASE (pio)->PIO_IFER = PIO_BITMASK_ (pio);
+}
+
+
+/** Disable glitch and debounce filters for specified PIO.  */
+static __always_inline__ void
+pio_input_filter_disable (pio_t pio)
+{
+    PIO_BASE (pio)->PIO_IFDR = PIO_BITMASK_ (pio);
+}
+
+
+/** Set debounce divider for the port of the specified PIO.  The
+    debounce period is 2 * (divider + 1) slow clock periods, giving a
+    maximum of about 1 s.  */
+static inline void
+pio_debounce_divider_set (pio_t pio, uint16_t divider)
+{
+    PIO_BASE (pio)->PIO_SCDR = PIO_SCDR_DIV (divider);
+}
+
+
+/** Get debounce divider for the port of the specified PIO.  */
+static inline uint16_t
+pio_debounce_divider_get (pio_t pio)
+{
+    return PIO_BASE (pio)->PIO_SCDR & PIO_SCDR_DIV_Msk;
+}
+
+
 
 #ifdef __cplusplus
 }
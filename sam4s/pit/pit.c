@@ -36,7 +36,7 @@ pit_stop (void)
 }
 
 
-static uint32_t pit_period_set (uint32_t period)
+uint32_t pit_period_set (uint32_t period)
 {
     /* For a period of 100 load 99.  */
     SysTick->LOAD = period;
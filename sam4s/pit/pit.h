@@ -40,6 +40,10 @@ pit_tick_t pit_wait_until (pit_tick_t when);
 pit_tick_t pit_wait (pit_tick_t period);
 
 
+/** Set pit reload value; the period is one more tick than this.  */
+uint32_t pit_period_set (uint32_t period);
+
+
 /** Initialise pit.  */
 int pit_init (void);
 
@@ -11,4 +11,4 @@ INCLUDES += -I$(MAT91LIB_DIR)/$(FAMILY) -I$(MAT91LIB_DIR)/$(FAMILY)/atmel
 
 VPATH += $(MAT91LIB_DIR)/$(FAMILY)
 
-SRC += mcu_sleep.c
+SRC += mcu_sleep.c mcu_boot_profile.c mcu_stack.c pio.c irq_profile.c
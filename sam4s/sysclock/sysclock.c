@@ -3,53 +3,462 @@
     @date   26 December 2023
     @brief This keeps track of time in terms of CPU clocks and
     provides delay functions.  It uses an interrupt every millisecond;
-    this can call a heartbeat function.
+    this can call a heartbeat function.  In tickless mode, the
+    interrupt only occurs for the next timer expiry.
 */
 
 #include "sysclock.h"
 #include "systick.h"
 #include "cpu.h"
 #include "irq.h"
+#include "mcu.h"
+#include "sys.h"
+
+
+#ifndef SYSCLOCK_IRQ_PRIORITY
+#define SYSCLOCK_IRQ_PRIORITY 15
+#endif
+
+
+/* The time is always counted in clocks at F_CPU so that
+   SYSCLOCK_MS_CLOCKS is constant.  If mcu_clock_set changes MCK,
+   SysTick is reprogrammed to keep a millisecond period and its count
+   is scaled to F_CPU clocks.  The partial millisecond at the time of
+   the change is lost.  With SYSCLOCK_USE_DWT, the cycle counter no
+   longer counts at F_CPU so the time is read from SysTick until MCK
+   is restored to F_CPU.  */
+
+
+#if SYSCLOCK_USE_DWT
+#if SYSCLOCK_TICKLESS
+#error SYSCLOCK_USE_DWT cannot be used with SYSCLOCK_TICKLESS
+#endif
+
+/* With SYSCLOCK_USE_DWT, the time is read from the 32 bit DWT cycle
+   counter, extended to 64 bits without masking interrupts.  The
+   SysTick handler counts the number of times the most significant bit
+   of the cycle counter has changed (the number of half periods).  If
+   the count is out of date, its least significant bit differs from
+   the most significant bit of the cycle counter and it is one less
+   than it should be.  This works provided the count is updated at
+   least every half period (22 s at 96 MHz); since only the SysTick
+   handler updates it, there are no races.
+
+   The cycle counter is clocked by the processor clock so it does not
+   count while the core sleeps or is halted by a debugger.  SysTick
+   keeps counting, so on every tick the handler compares the time from
+   the cycle counter with the time from the millisecond count and
+   increases a 64 bit offset, added to the cycle counter, if it has
+   fallen behind.  The cycle counter itself is left free running since
+   it is shared with other users.
+
+   The offset is double buffered so that it can be updated without
+   masking interrupts.  The handler writes the new offset into the
+   unused slot and then increments the sequence count, whose least
+   significant bit selects the slot.  A reader that preempts the
+   handler sees the old slot, which is unchanged.  A reader that is
+   preempted by the handler sees the sequence count change and reads
+   again.  Thus the time is at most a millisecond out after the core
+   wakes, until the next tick.  */
+
+/* The offset is only increased if the time is behind by more than
+   this many clocks.  This ignores the few clocks between reading
+   SysTick and the cycle counter.  */
+#ifndef SYSCLOCK_DWT_RESYNC_MARGIN
+#define SYSCLOCK_DWT_RESYNC_MARGIN 64
+#endif
+#endif
+
+
+#if SYSCLOCK_TICKLESS
+/* In tickless mode, SysTick is used as a down counter that is
+   restarted to interrupt at the next timer expiry.  The time is the
+   clock count when SysTick was last restarted (base) plus the count
+   since then.  When SysTick reloads, a whole period has elapsed and
+   this is added to base.
+
+   When SysTick is restarted, the count since the last restart is
+   added to base.  The few clocks between reading and writing the
+   counter are measured with the cycle counter.  Thus the time only
+   drifts by a clock or so per restart.  SysTick is not restarted if
+   there are no timers and it is already free running with the longest
+   period.  */
+
+/* Longest SysTick period.  This is 0.17 s at 96 MHz.  */
+#define SYSCLOCK_PERIOD_MAX (1 << 24)
+
+/* Shortest SysTick period.  This ensures that the handler returns
+   before the next interrupt.  */
+#ifndef SYSCLOCK_PERIOD_MIN
+#define SYSCLOCK_PERIOD_MIN 512
+#endif
+
+/* Don't restart if SysTick is about to reload since the reload would
+   be missed.  */
+#define SYSCLOCK_RESTART_MARGIN 32
+#endif
 
 
 typedef struct sysclock_dev_struct
 {
     // This rolls over about every 50 days
     volatile uint32_t millis;
+    // Number of SysTick clocks per millisecond at the current MCK
+    uint32_t ms_period;
+    // Saved by the clock change notifier
+    irq_state_t irq_state;
     sysclock_callback_t callback;
+    // List of active timers sorted by expiry
+    sysclock_timer_t *timers;
+#if SYSCLOCK_USE_DWT
+    // Number of changes of the cycle counter most significant bit
+    volatile uint32_t halves;
+    // Incremented when the offset is changed; the LSB selects the offset
+    volatile uint32_t seq;
+    // Clocks the cycle counter did not count while the core slept
+    volatile sysclock_clocks_t offset[2];
+    // Time from the cycle counter when SysTick was started
+    sysclock_clocks_t origin;
+#endif
+#if SYSCLOCK_TICKLESS
+    // Clocks when SysTick was last restarted
+    volatile sysclock_clocks_t base;
+    // Current SysTick period
+    volatile uint32_t period;
+    sysclock_timer_t tick_timer;
+#endif
 } sysclock_dev_t;
 
 
 static sysclock_dev_t sysclock_dev;
 
 
+// Convert SysTick clocks at the current MCK to clocks at F_CPU.
+static inline uint32_t sysclock_scale (uint32_t clocks)
+{
+    if (sysclock_dev.ms_period == SYSCLOCK_MS_CLOCKS)
+        return clocks;
+    return (uint64_t)clocks * SYSCLOCK_MS_CLOCKS / sysclock_dev.ms_period;
+}
+
+
+#if SYSCLOCK_TICKLESS
+// Convert clocks at F_CPU to SysTick clocks at the current MCK.
+static inline sysclock_clocks_t sysclock_unscale (sysclock_clocks_t clocks)
+{
+    if (sysclock_dev.ms_period == SYSCLOCK_MS_CLOCKS)
+        return clocks;
+    return clocks * sysclock_dev.ms_period / SYSCLOCK_MS_CLOCKS;
+}
+#endif
+
+
+#if SYSCLOCK_USE_DWT
+static inline sysclock_clocks_t sysclock_clocks_dwt (void)
+{
+    uint32_t halves;
+    uint32_t low;
+    uint32_t seq;
+    sysclock_clocks_t offset;
+
+    // The order of the reads is important.
+    do
+    {
+        seq = sysclock_dev.seq;
+        __DMB ();
+        offset = sysclock_dev.offset[seq & 1];
+        halves = sysclock_dev.halves;
+        __DMB ();
+        low = cpu_cycle_counter_get ();
+        __DMB ();
+    } while (seq != sysclock_dev.seq);
+
+    if ((low >> 31) != (halves & 1))
+        halves++;
+
+    return (((sysclock_clocks_t)(halves >> 1) << 32) | low) + offset;
+}
+
+
+// This is called from the SysTick handler.
+static inline void sysclock_dwt_update (void)
+{
+    uint32_t halves;
+
+    halves = sysclock_dev.halves;
+    if ((cpu_cycle_counter_get () >> 31) != (halves & 1))
+        sysclock_dev.halves = halves + 1;
+}
+#endif
+
+
+#if !SYSCLOCK_TICKLESS
+// Return the time from the millisecond count.  This must be called
+// with the SysTick interrupt masked.
+static sysclock_clocks_t sysclock_clocks_systick (void)
+{
+    uint32_t millis1;
+    uint32_t val;
+
+    millis1 = sysclock_dev.millis;
+    val = SysTick->VAL;
+
+    // Look for pending systick interrupt.  The counter may have
+    // reloaded after it was read so read it again.
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        millis1++;
+        val = SysTick->VAL;
+    }
+
+    // The counter reaches zero at the end of the millisecond and is
+    // then reloaded.
+    return (sysclock_clocks_t)millis1 * SYSCLOCK_MS_CLOCKS
+        + (val ? sysclock_scale (sysclock_dev.ms_period - val) : 0);
+}
+#endif
+
+
+#if SYSCLOCK_USE_DWT
+// Return true if the cycle counter counts at F_CPU.
+static inline bool sysclock_dwt_p (void)
+{
+    return sysclock_dev.ms_period == SYSCLOCK_MS_CLOCKS;
+}
+
+
+// Increase the offset if the cycle counter has stopped while the core
+// slept.  If force is true, set it regardless.  This is called from
+// the SysTick handler and the clock change notifier, with the SysTick
+// interrupt masked, so there is only one writer.
+static void sysclock_dwt_resync (bool force)
+{
+    sysclock_clocks_t expected;
+    sysclock_clocks_t clocks;
+    uint32_t seq;
+
+    expected = sysclock_dev.origin + sysclock_clocks_systick ();
+    clocks = sysclock_clocks_dwt ();
+    if (force || clocks + SYSCLOCK_DWT_RESYNC_MARGIN < expected)
+    {
+        seq = sysclock_dev.seq;
+        sysclock_dev.offset[(seq + 1) & 1]
+            = sysclock_dev.offset[seq & 1] + expected - clocks;
+        __DMB ();
+        sysclock_dev.seq = seq + 1;
+    }
+}
+#endif
+
+
+// This must be called with the SysTick interrupt masked.
+static sysclock_clocks_t sysclock_clocks_masked (void)
+{
+#if SYSCLOCK_USE_DWT
+    if (sysclock_dwt_p ())
+        return sysclock_clocks_dwt ();
+    return sysclock_dev.origin + sysclock_clocks_systick ();
+#elif SYSCLOCK_TICKLESS
+    sysclock_clocks_t base;
+    uint32_t val;
+
+    base = sysclock_dev.base;
+    val = SysTick->VAL;
+
+    // Look for pending systick interrupt.  The counter may have
+    // reloaded after it was read so read it again.
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        base += sysclock_scale (sysclock_dev.period);
+        val = SysTick->VAL;
+    }
+
+    // The counter reaches zero at the end of the period and is then
+    // reloaded.
+    return base + (val ? sysclock_scale (sysclock_dev.period - val) : 0);
+#else
+    return sysclock_clocks_systick ();
+#endif
+}
+
+
+#if SYSCLOCK_TICKLESS
+// Restart SysTick to interrupt after period clocks.  This must be
+// called with the SysTick interrupt masked.
+static void sysclock_restart (uint32_t period)
+{
+    uint32_t val;
+    uint32_t start;
+    uint32_t elapsed;
+
+    do
+    {
+        val = SysTick->VAL;
+        start = cpu_cycle_counter_get ();
+    } while (val != 0 && val < SYSCLOCK_RESTART_MARGIN);
+
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        // The period has finished but the handler has not run.  The
+        // timers are checked at the end of the new period.
+        sysclock_dev.base += sysclock_scale (sysclock_dev.period);
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+        val = SysTick->VAL;
+        start = cpu_cycle_counter_get ();
+    }
+
+    elapsed = val ? sysclock_dev.period - val : 0;
+
+    SysTick->LOAD = period - 1;
+    // This clears the counter; it is reloaded on the next clock.
+    SysTick->VAL = 0;
+
+    elapsed += cpu_cycle_counter_get () - start;
+    sysclock_dev.base += sysclock_scale (elapsed);
+    sysclock_dev.period = period;
+}
+
+
+// Set the SysTick period for the next timer expiry.  This must be
+// called with the SysTick interrupt masked.
+static void sysclock_schedule (void)
+{
+    sysclock_clocks_t now;
+    sysclock_clocks_t delay;
+
+    if (!sysclock_dev.timers)
+    {
+        if (sysclock_dev.period != SYSCLOCK_PERIOD_MAX)
+            sysclock_restart (SYSCLOCK_PERIOD_MAX);
+        return;
+    }
+
+    now = sysclock_clocks_masked ();
+    delay = 0;
+    if (sysclock_dev.timers->expiry > now)
+        delay = sysclock_unscale (sysclock_dev.timers->expiry - now);
+    if (delay < SYSCLOCK_PERIOD_MIN)
+        delay = SYSCLOCK_PERIOD_MIN;
+    if (delay > SYSCLOCK_PERIOD_MAX)
+        delay = SYSCLOCK_PERIOD_MAX;
+
+    sysclock_restart (delay);
+}
+#endif
+
+
+// Remove timer from list.  This must be called with the SysTick
+// interrupt masked.
+static void sysclock_timer_remove (sysclock_timer_t *timer)
+{
+    sysclock_timer_t **prev;
+
+    for (prev = &sysclock_dev.timers; *prev; prev = &(*prev)->next)
+    {
+        if (*prev == timer)
+        {
+            *prev = timer->next;
+            break;
+        }
+    }
+    timer->active = 0;
+}
+
+
+// Insert timer into list sorted by expiry.  This must be called with
+// the SysTick interrupt masked.
+static void sysclock_timer_insert (sysclock_timer_t *timer)
+{
+    sysclock_timer_t **prev;
+
+    for (prev = &sysclock_dev.timers; *prev; prev = &(*prev)->next)
+    {
+        if (timer->expiry < (*prev)->expiry)
+            break;
+    }
+    timer->next = *prev;
+    *prev = timer;
+    timer->active = 1;
+}
+
+
+// Call the handlers for the expired timers.  This is called from the
+// SysTick handler.
+static void sysclock_timers_run (void)
+{
+    sysclock_clocks_t now;
+    sysclock_timer_t *timer;
+
+    now = sysclock_clocks_masked ();
+
+    while (sysclock_dev.timers && sysclock_dev.timers->expiry <= now)
+    {
+        timer = sysclock_dev.timers;
+        sysclock_dev.timers = timer->next;
+        timer->active = 0;
+
+        if (timer->period)
+        {
+            timer->expiry += timer->period;
+            // Don't try to catch up if the expiries have been missed.
+            if (timer->expiry <= now)
+                timer->expiry = now + timer->period;
+            sysclock_timer_insert (timer);
+        }
+
+        // The handler can restart or stop this or other timers.
+        if (timer->callback)
+            timer->callback (timer->arg);
+    }
+}
+
+
 static void sysclock_handler (void)
 {
+#if SYSCLOCK_TICKLESS
+    // The period has finished.
+    sysclock_dev.base += sysclock_scale (sysclock_dev.period);
+
+    sysclock_timers_run ();
+
+    sysclock_schedule ();
+#else
     // This is called every millisecond.
 
     sysclock_dev.millis++;
 
+#if SYSCLOCK_USE_DWT
+    if (sysclock_dwt_p ())
+        sysclock_dwt_resync (0);
+    sysclock_dwt_update ();
+#endif
+
     // If this takes more than a millisecond, timing will drift.
     if (sysclock_dev.callback)
         sysclock_dev.callback ();
+
+    if (sysclock_dev.timers)
+        sysclock_timers_run ();
+#endif
 }
 
 
 sysclock_clocks_t sysclock_clocks (void)
 {
-    uint32_t millis1;
     sysclock_clocks_t clocks;
+    irq_state_t irq_state;
 
-    irq_global_disable ();
-    millis1 = sysclock_dev.millis;
-
-    // Look for pending systick interrupt
-    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
-        millis1++;
+#if SYSCLOCK_USE_DWT
+    // No masking is required.
+    if (sysclock_dwt_p ())
+        return sysclock_clocks_dwt ();
+#endif
 
-    irq_global_enable ();
-
-    clocks = (sysclock_clocks_t)millis1 * SYSCLOCK_MS_CLOCKS + systick_clocks_get ();
+    // Only the SysTick interrupt needs masking; higher priority
+    // interrupts can still be serviced.
+    irq_state = irq_critical_enter (SYSCLOCK_IRQ_PRIORITY);
+    clocks = sysclock_clocks_masked ();
+    irq_critical_exit (irq_state);
 
     return clocks;
 }
@@ -57,7 +466,11 @@ sysclock_clocks_t sysclock_clocks (void)
 
 uint32_t sysclock_millis (void)
 {
+#if SYSCLOCK_TICKLESS
+    return sysclock_clocks () / SYSCLOCK_MS_CLOCKS;
+#else
     return sysclock_dev.millis;
+#endif
 }
 
 
@@ -76,6 +489,25 @@ uint32_t sysclock_micros (void)
 
 void sysclock_millis_delay (uint32_t delay_ms)
 {
+#if SYSCLOCK_TICKLESS
+    sysclock_timer_t timer;
+
+    // The timer ensures that there is an interrupt at the end of the
+    // delay.
+    sysclock_timer_start (&timer, (sysclock_clocks_t)delay_ms
+                          * SYSCLOCK_MS_CLOCKS, 0, 0, 0);
+    while (sysclock_clocks () < timer.expiry)
+        cpu_wfi ();
+    sysclock_timer_stop (&timer);
+#elif SYSCLOCK_USE_DWT
+    uint32_t start;
+
+    // Count SysTick interrupts since the cycle counter may not count
+    // while sleeping.
+    start = sysclock_dev.millis;
+    while (sysclock_dev.millis - start <= delay_ms)
+        cpu_wfi ();
+#else
     sysclock_clocks_t now;
 
     now = sysclock_clocks ();
@@ -83,6 +515,7 @@ void sysclock_millis_delay (uint32_t delay_ms)
     // than 1 ms.
     while (sysclock_clocks () < now + delay_ms * SYSCLOCK_MS_CLOCKS)
         cpu_wfi ();
+#endif
 }
 
 
@@ -116,21 +549,155 @@ bool sysclock_micros_elapsed (sysclock_clocks_t from_clocks, uint32_t delay_us)
 }
 
 
+void sysclock_timer_start (sysclock_timer_t *timer, sysclock_clocks_t delay,
+                           sysclock_clocks_t period,
+                           sysclock_timer_callback_t callback, void *arg)
+{
+    irq_state_t irq_state;
+
+    irq_state = irq_critical_enter (SYSCLOCK_IRQ_PRIORITY);
+
+    if (timer->active)
+        sysclock_timer_remove (timer);
+
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->period = period;
+    timer->expiry = sysclock_clocks_masked () + delay;
+    sysclock_timer_insert (timer);
+
+#if SYSCLOCK_TICKLESS
+    // Reschedule if this timer expires before the next interrupt.
+    if (sysclock_dev.timers == timer)
+        sysclock_schedule ();
+#endif
+
+    irq_critical_exit (irq_state);
+}
+
+
+void sysclock_timer_stop (sysclock_timer_t *timer)
+{
+    irq_state_t irq_state;
+
+    irq_state = irq_critical_enter (SYSCLOCK_IRQ_PRIORITY);
+
+    // The SysTick interrupt is left scheduled for the old expiry
+    // since it is harmless.
+    if (timer->active)
+        sysclock_timer_remove (timer);
+
+    irq_critical_exit (irq_state);
+}
+
+
+bool sysclock_timer_active_p (sysclock_timer_t *timer)
+{
+    return timer->active;
+}
+
+
+void sysclock_wakeup (uint32_t delay_us)
+{
+    static sysclock_timer_t wakeup_timer;
+
+    // The interrupt is enough to wake the core so no callback is
+    // needed.
+    sysclock_timer_start (&wakeup_timer,
+                          (sysclock_clocks_t)delay_us * SYSCLOCK_MS_CLOCKS
+                          / 1000, 0, 0, 0);
+}
+
+
+#if SYSCLOCK_TICKLESS
+static void sysclock_tick_callback (void *arg)
+{
+    sysclock_dev.callback ();
+}
+#endif
+
+
 void sysclock_callback (sysclock_callback_t callback)
 {
     // Could register multiple callbacks;
     sysclock_dev.callback = callback;
+
+#if SYSCLOCK_TICKLESS
+    // The heartbeat needs a periodic timer.
+    if (callback)
+        sysclock_timer_start (&sysclock_dev.tick_timer, SYSCLOCK_MS_CLOCKS,
+                              SYSCLOCK_MS_CLOCKS, sysclock_tick_callback, 0);
+    else
+        sysclock_timer_stop (&sysclock_dev.tick_timer);
+#endif
+}
+
+
+// Keep the time when MCK is changed by mcu_clock_set.  The SysTick
+// interrupt is masked during the change.
+static void sysclock_clock_notify (void *arg, mcu_clock_event_t event,
+                                   uint32_t f_mck)
+{
+    if (event == MCU_CLOCK_CHANGE_PRE)
+    {
+        sysclock_dev.irq_state = irq_critical_enter (SYSCLOCK_IRQ_PRIORITY);
+#if SYSCLOCK_TICKLESS
+        // Add the time at the old rate to base.
+        sysclock_restart (sysclock_dev.period);
+#endif
+        return;
+    }
+
+#if SYSCLOCK_TICKLESS
+    sysclock_restart (sysclock_dev.period);
+    sysclock_dev.ms_period = f_mck / 1000;
+    sysclock_schedule ();
+#else
+    sysclock_dev.ms_period = f_mck / 1000;
+    SysTick->LOAD = sysclock_dev.ms_period - 1;
+    // This restarts the millisecond.
+    SysTick->VAL = 0;
+#if SYSCLOCK_USE_DWT
+    // The cycle counter has been counting at the wrong rate.
+    if (sysclock_dwt_p ())
+        sysclock_dwt_resync (1);
+#endif
+#endif
+
+    irq_critical_exit (sysclock_dev.irq_state);
 }
 
 
 int
 sysclock_init (void)
 {
-    systick_init (SYSCLOCK_MS_CLOCKS);
+    if (!mcu_clock_notify_register (sysclock_clock_notify, 0))
+        return 0;
+
+    sysclock_dev.ms_period = mcu_clock_get () / 1000;
+
+#if SYSCLOCK_TICKLESS
+    sysclock_dev.base = 0;
+    sysclock_dev.period = SYSCLOCK_PERIOD_MAX;
+    systick_init (SYSCLOCK_PERIOD_MAX);
+#else
+#if SYSCLOCK_USE_DWT
+    cpu_cycle_counter_enable ();
+    sysclock_dev.halves = cpu_cycle_counter_get () >> 31;
+#endif
+    systick_init (sysclock_dev.ms_period);
+#if SYSCLOCK_USE_DWT
+    sysclock_dev.origin = sysclock_clocks_dwt () - sysclock_clocks_systick ();
+#endif
+#endif
     // Set to lowest priority
-    irq_config (SysTick_IRQn, 15, sysclock_handler);
+    irq_config (SysTick_IRQn, SYSCLOCK_IRQ_PRIORITY, sysclock_handler);
 
     // Enable SysTick interrupt.
     SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+
+    // Measure the sys timeouts with a time base that runs while asleep.
+    sys_micros_set (sysclock_micros);
+    sys_wakeup_set (sysclock_wakeup);
     return 1;
 }
@@ -13,6 +13,22 @@ extern "C" {
 
 #include "config.h"
 
+
+/* Define SYSCLOCK_TICKLESS as 1 in config.h to only interrupt when a
+   timer expires rather than every millisecond.  This allows the CPU
+   to sleep for longer.  */
+#ifndef SYSCLOCK_TICKLESS
+#define SYSCLOCK_TICKLESS 0
+#endif
+
+
+/* Define SYSCLOCK_USE_DWT as 1 in config.h to read the time from the
+   DWT cycle counter.  This is faster and does not mask interrupts so
+   sysclock_clocks can be used from any interrupt handler.  */
+#ifndef SYSCLOCK_USE_DWT
+#define SYSCLOCK_USE_DWT 0
+#endif
+
 // Number of clocks per millisecond.
 #define SYSCLOCK_MS_CLOCKS ((int)(F_CPU * 1e-3))
 
@@ -25,6 +41,21 @@ typedef uint64_t sysclock_clocks_t;
 
 typedef void (*sysclock_callback_t) (void);
 
+typedef void (*sysclock_timer_callback_t) (void *arg);
+
+
+/** Timer object.  This is usually statically allocated; the fields
+    are private.  */
+typedef struct sysclock_timer_struct
+{
+    sysclock_timer_callback_t callback;
+    void *arg;
+    sysclock_clocks_t expiry;
+    sysclock_clocks_t period;
+    struct sysclock_timer_struct *next;
+    volatile bool active;
+} sysclock_timer_t;
+
 
 sysclock_clocks_t sysclock_clocks (void);
 
@@ -44,10 +75,37 @@ bool sysclock_millis_elapsed (sysclock_clocks_t from, uint32_t delay);
 bool sysclock_micros_elapsed (sysclock_clocks_t from, uint32_t delay);
 
 
+/** Register a function to be called every millisecond from the
+    SysTick interrupt handler.  In tickless mode, this uses a periodic
+    timer.  */
 void sysclock_callback (sysclock_callback_t callback);
 
 
-/** Initialise sysclock.  */
+/** Start timer to expire after delay clocks and then every period
+    clocks (if non-zero).  The callback is called from the SysTick
+    interrupt handler and can be null.  Without tickless mode, the
+    timer resolution is 1 ms.  A running timer is restarted.  */
+void sysclock_timer_start (sysclock_timer_t *timer, sysclock_clocks_t delay,
+                           sysclock_clocks_t period,
+                           sysclock_timer_callback_t callback, void *arg);
+
+
+/** Stop timer.  */
+void sysclock_timer_stop (sysclock_timer_t *timer);
+
+
+/** Return true if timer is running.  */
+bool sysclock_timer_active_p (sysclock_timer_t *timer);
+
+
+/** Start a timer whose interrupt wakes the core from a sleep after
+    delay_us.  This is used to bound the sleep while waiting for a
+    device.  */
+void sysclock_wakeup (uint32_t delay_us);
+
+
+/** Initialise sysclock.  Return zero if the clock notifier cannot be
+    registered.  */
 int sysclock_init (void);
 
 
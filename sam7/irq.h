@@ -114,6 +114,49 @@ void irq_global_enable (void)
     cpu_cpsr_set (cpsr);
 }
 
+
+/* Critical sections.  The AIC cannot mask interrupts by priority so
+   these mask all the interrupts.  The previous state is restored on
+   exit so they can be nested.  This only works in ARM mode.  */
+
+typedef uint32_t irq_state_t;
+
+
+__inline __attribute__ ((always_inline)) 
+irq_state_t irq_global_save (void)
+{
+    uint32_t cpsr;
+
+    cpsr = cpu_cpsr_get ();
+    cpu_cpsr_set (cpsr | CPU_I_BIT | CPU_F_BIT);
+    return cpsr & (CPU_I_BIT | CPU_F_BIT);
+}
+
+
+__inline __attribute__ ((always_inline)) 
+void irq_global_restore (irq_state_t state)
+{
+    uint32_t cpsr;
+
+    cpsr = cpu_cpsr_get ();
+    cpsr &= ~(CPU_I_BIT | CPU_F_BIT);
+    cpu_cpsr_set (cpsr | state);
+}
+
+
+__inline __attribute__ ((always_inline)) 
+irq_state_t irq_critical_enter (irq_priority_t priority)
+{
+    return irq_global_save ();
+}
+
+
+__inline __attribute__ ((always_inline)) 
+void irq_critical_exit (irq_state_t state)
+{
+    irq_global_restore (state);
+}
+
 #ifdef __cplusplus
 }
 #endif    
@@ -135,3 +135,47 @@ void mcu_cpu_idle (void)
     while ((PMC->PMC_SCSR & AT91C_PMC_PCK) != AT91C_PMC_PCK)
         continue;
 }
+
+
+/* Number of references to each peripheral clock.  */
+static uint8_t mcu_pmc_refs[MCU_PMC_ID_NUM];
+
+
+void
+mcu_pmc_acquire (uint8_t id)
+{
+    irq_state_t irq_state;
+
+    if (id >= MCU_PMC_ID_NUM)
+        return;
+
+    /* This may be called from interrupt handlers.  */
+    irq_state = irq_global_save ();
+    if (mcu_pmc_refs[id]++ == 0)
+        mcu_pmc_enable (id);
+    irq_global_restore (irq_state);
+}
+
+
+void
+mcu_pmc_release (uint8_t id)
+{
+    irq_state_t irq_state;
+
+    if (id >= MCU_PMC_ID_NUM)
+        return;
+
+    irq_state = irq_global_save ();
+    if (mcu_pmc_refs[id] && --mcu_pmc_refs[id] == 0)
+        mcu_pmc_disable (id);
+    irq_global_restore (irq_state);
+}
+
+
+uint8_t
+mcu_pmc_refs_get (uint8_t id)
+{
+    if (id >= MCU_PMC_ID_NUM)
+        return 0;
+    return mcu_pmc_refs[id];
+}
@@ -313,10 +313,63 @@ mcu_pmc_disable (uint8_t id)
     PMC->PMC_PCDR = BIT (id);
 }
 
+
+/* Number of peripheral clock identifiers.  */
+#define MCU_PMC_ID_NUM 32
+
+
+/** Acquire a reference to the peripheral clock for ID.  The clock is
+    enabled for the first reference.  Each call must be balanced by a
+    call to mcu_pmc_release.  */
+void
+mcu_pmc_acquire (uint8_t id);
+
+
+/** Release a reference to the peripheral clock for ID.  The clock is
+    disabled when the last reference is released.  */
+void
+mcu_pmc_release (uint8_t id);
+
+
+/** Return the number of references to the peripheral clock for ID.  */
+uint8_t
+mcu_pmc_refs_get (uint8_t id);
+
 void
 mcu_cpu_idle (void);
 
 
+typedef enum
+{
+    MCU_CLOCK_CHANGE_PRE,
+    MCU_CLOCK_CHANGE_POST
+} mcu_clock_event_t;
+
+
+typedef void (*mcu_clock_notify_t) (void *arg, mcu_clock_event_t event,
+                                    uint32_t f_mck);
+
+
+/* The boot profiler is not supported on the SAM7.  */
+#define BOOT_PROFILE_MARK(NAME)
+
+
+/** Return the MCK frequency.  This is fixed on the SAM7.  */
+static inline uint32_t
+mcu_clock_get (void)
+{
+    return F_CPU;
+}
+
+
+/** Since the clock is fixed, the notifier is never called.  */
+static inline bool
+mcu_clock_notify_register (mcu_clock_notify_t notify, void *arg)
+{
+    return 1;
+}
+
+
 
 #ifdef __cplusplus
 }
@@ -44,7 +44,7 @@ pit_stop (void)
 }
 
 
-static uint32_t pit_period_set (uint32_t period)
+uint32_t pit_period_set (uint32_t period)
 {
     BITS_INSERT (pPITC->PITC_PIMR, period, 0, 19);
 
@@ -105,6 +105,12 @@ enum
 
 #define SPI_BASE_GET(channel) (((channel) < SPI_CHANNELS_NUM) ? SPI0 : SPI1)
 
+#if SPI_CONTROLLERS_NUM == 2
+#define SPI_ID_GET(spi) (((spi)->base == SPI0) ? ID_SPI : ID_SPI1)
+#else
+#define SPI_ID_GET(spi) ID_SPI
+#endif
+
 
 #ifdef HOSTED
 #define SPI_READY_P(BASE) (HOSTED || ((BASE)->SPI_SR & SPI_SR_RDRF))
@@ -348,6 +354,7 @@ spi_clock_divisor_set (spi_t spi, spi_clock_divisor_t clock_divisor)
     if (clock_divisor == 0)
         clock_divisor = 1;
     spi->clock_divisor = clock_divisor;
+    spi->clock_speed_kHz = 0;
     spi_update (spi);
 }
 
@@ -357,13 +364,15 @@ spi_clock_speed_kHz_set (spi_t spi, spi_clock_speed_t clock_speed_kHz)
 {
     uint32_t clock_speed;
     uint32_t divisor;
+    uint32_t f_mck;
 
     clock_speed = clock_speed_kHz * 1000;
+    f_mck = mcu_clock_get ();
 
     /* Calculate the appropriate clock divisor. This must be in the range 1 to
      * 255 inclusive. Adding the speed and subtracting 1 rounds up when used
      * with integer division.  */
-    divisor = (F_CPU_UL + clock_speed - 1) / clock_speed;
+    divisor = (f_mck + clock_speed - 1) / clock_speed;
     if (divisor > 255)
         divisor = 255;
     else if (divisor == 0)
@@ -371,11 +380,32 @@ spi_clock_speed_kHz_set (spi_t spi, spi_clock_speed_t clock_speed_kHz)
 
     /* Set the divisor and return the actual clock speed. */
     spi_clock_divisor_set (spi, (spi_clock_divisor_t)divisor);
-    clock_speed = F_CPU / spi->clock_divisor;
+    spi->clock_speed_kHz = clock_speed_kHz;
+    clock_speed = f_mck / spi->clock_divisor;
     return clock_speed / 1000;
 }
 
 
+/* Recompute the clock divisors when MCK changes.  The new divisor
+   takes effect when the device is next configured.  */
+static void
+spi_clock_notify (void *arg, mcu_clock_event_t event, uint32_t f_mck)
+{
+    unsigned int i;
+
+    if (event != MCU_CLOCK_CHANGE_POST)
+        return;
+
+    for (i = 0; i < spi_devices_num; i++)
+    {
+        spi_t spi = &spi_devices[i];
+
+        if (spi->clock_speed_kHz)
+            spi_clock_speed_kHz_set (spi, spi->clock_speed_kHz);
+    }
+}
+
+
 void
 spi_cs_hold_set (spi_t spi, uint16_t delay)
 {
@@ -556,25 +586,28 @@ spi_wakeup (spi_t spi)
     pio_config_set (MOSI0_PIO, MOSI0_PERIPH);
     pio_config_set (SPCK0_PIO, SPCK0_PERIPH);
 
-    /* Enable SPI peripheral clock.  */
-    mcu_pmc_enable (ID_SPI);
+    /* The SPI peripheral clock is only enabled for the transfers.  */
+    mcu_pmc_acquire (ID_SPI);
 
     spi_reset (SPI0);
     spi_setup (SPI0);
     spi_enable (SPI0);
 
+    mcu_pmc_release (ID_SPI);
+
 #if SPI_CONTROLLERS_NUM == 2
     /* Configure PIO for MISO, MOSI, SPCK.    */
     pio_config_set (MISO1_PIO, MISO0_PERIPH);
     pio_config_set (MOSI1_PIO, MOSI1_PERIPH);
     pio_config_set (SPCK1_PIO, SPCK1_PERIPH);
 
-    /* Enable SPI peripheral clock.  */
-    mcu_pmc_enable (ID_SPI1);
+    mcu_pmc_acquire (ID_SPI1);
 
     spi_reset (SPI1);
     spi_setup (SPI1);
     spi_enable (SPI1);
+
+    mcu_pmc_release (ID_SPI1);
 #endif
 }
 
@@ -591,6 +624,12 @@ spi_init (const spi_cfg_t *cfg)
         return 0;
     }
 
+    if (!mcu_clock_notify_register (spi_clock_notify, 0))
+    {
+        errno = ENOSPC;
+        return 0;
+    }
+
     spi = spi_devices + spi_devices_num;
     spi_devices_num++;
 
@@ -640,27 +679,24 @@ spi_shutdown (spi_t spi)
     if (spi_devices_enabled)
         return;
 
+    mcu_pmc_acquire (ID_SPI);
     spi_disable (SPI0);
+    mcu_pmc_release (ID_SPI);
 
 #if SPI_CONTROLLERS_NUM == 2
+    mcu_pmc_acquire (ID_SPI1);
     spi_disable (SPI1);
+    mcu_pmc_release (ID_SPI1);
 
     /* Force lines low to prevent powering devices.  */
     pio_config_set (MISO1_PIO, PIO_OUTPUT_LOW);
     pio_config_set (MOSI1_PIO, PIO_OUTPUT_LOW);
     pio_config_set (SPCK1_PIO, PIO_OUTPUT_LOW);
-
-    /* Disable SPI peripheral clocks.  */
-    mcu_pmc_disable (ID_SPI);
-    mcu_pmc_disable (ID_SPI1);
 #else
     /* Force lines low to prevent powering devices.  */
     pio_config_set (MISO0_PIO, PIO_OUTPUT_LOW);
     pio_config_set (MOSI0_PIO, PIO_OUTPUT_LOW);
     pio_config_set (SPCK0_PIO, PIO_OUTPUT_LOW);
-
-    /* Disable SPI peripheral clock.  */
-    mcu_pmc_disable (ID_SPI);
 #endif
 
     /* Set all the chip select pins low.  */
@@ -672,7 +708,29 @@ spi_shutdown (spi_t spi)
 }
 
 
-spi_ret_t
+/* Enable the controller clock and program the channel registers.
+   This is done by the callers of spi_transfer_8 and spi_transfer_16
+   so that these do not call flash-resident code when placed in
+   SRAM.  */
+static void
+spi_transfer_begin (spi_t spi)
+{
+    /* The controller clock is only enabled for the transfer.  */
+    mcu_pmc_acquire (SPI_ID_GET (spi));
+
+    spi_config (spi);
+}
+
+
+static void
+spi_transfer_end (spi_t spi)
+{
+    mcu_pmc_release (SPI_ID_GET (spi));
+}
+
+
+__ramfunc_if__ (MAT91LIB_RAMFUNC_LOOP)
+static spi_ret_t
 spi_transfer_8 (spi_t spi, const void *txbuffer, void *rxbuffer,
                 spi_size_t len, bool terminate)
 {
@@ -682,8 +740,6 @@ spi_transfer_8 (spi_t spi, const void *txbuffer, void *rxbuffer,
     uint8_t rx;
     uint8_t tx = 0;
 
-    spi_config (spi);
-
     i = 0;
     switch (spi->cs_mode)
     {
@@ -766,7 +822,8 @@ spi_transfer_8 (spi_t spi, const void *txbuffer, void *rxbuffer,
 }
 
 
-spi_ret_t
+__ramfunc_if__ (MAT91LIB_RAMFUNC_LOOP)
+static spi_ret_t
 spi_transfer_16 (spi_t spi, const void *txbuffer, void *rxbuffer,
                  spi_size_t len, bool terminate)
 {
@@ -776,8 +833,6 @@ spi_transfer_16 (spi_t spi, const void *txbuffer, void *rxbuffer,
     uint16_t rx;
     uint16_t tx = 0;
 
-    spi_config (spi);
-
     i = 0;
     switch (spi->cs_mode)
     {
@@ -864,13 +919,18 @@ spi_ret_t
 spi_transfer (spi_t spi, const void *txbuffer, void *rxbuffer,
               spi_size_t len, bool terminate)
 {
+    spi_ret_t ret;
+
     /* If terminate is zero we should lock the SPI peripheral
        for this device until terminate is non-zero.  */
 
+    spi_transfer_begin (spi);
     if (spi->bits <= 8)
-        return spi_transfer_8 (spi, txbuffer, rxbuffer, len, terminate);
+        ret = spi_transfer_8 (spi, txbuffer, rxbuffer, len, terminate);
     else
-        return spi_transfer_16 (spi, txbuffer, rxbuffer, len, terminate);
+        ret = spi_transfer_16 (spi, txbuffer, rxbuffer, len, terminate);
+    spi_transfer_end (spi);
+    return ret;
 }
 
 
@@ -936,7 +996,9 @@ spi_xferc (spi_t spi, char ch)
     uint8_t rxdata;
 
     txdata = ch;
+    spi_transfer_begin (spi);
     spi_transfer_8 (spi, &txdata, &rxdata, sizeof (txdata), 1);
+    spi_transfer_end (spi);
 
     return rxdata;
 }
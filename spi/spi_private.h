@@ -21,6 +21,8 @@ typedef struct spi_dev_struct
     uint8_t channel;
     uint8_t bits;
     uint16_t clock_divisor;
+    /* Requested clock speed; zero if the divisor was set directly.  */
+    uint32_t clock_speed_kHz;
     /* Delay from CS asserted (set low) until SPI transfer starts.  */
     uint16_t cs_setup;
     /* Delay from CS negated (set high) after SPI transfer stops.  */
@@ -197,7 +197,7 @@ static void
 ssc_config_set (ssc_t ssc, const ssc_cfg_t *cfg)
 {
     /* Enable the peripheral clock.  */
-    mcu_pmc_enable (ID_SSC);
+    mcu_pmc_acquire (ID_SSC);
 
     /* Reset receiver and transmitter.  */
     SSC->SSC_CR = SSC_CR_SWRST | SSC_CR_RXDIS | SSC_CR_TXDIS;
@@ -348,6 +348,43 @@ ssc_enable (ssc_t ssc)
 }
 
 
+/* Wait until the receiver has data.  With MCU_IDLE_WAIT, the core
+   sleeps until the RXRDY interrupt becomes pending.  */
+static inline void
+ssc_read_wait (ssc_t ssc)
+{
+#if MCU_IDLE_WAIT
+    if (ssc_read_ready_p (ssc))
+        return;
+
+    SSC->SSC_IER = SSC_IER_RXRDY;
+    MCU_WAIT_UNTIL (ssc_read_ready_p (ssc), ID_SSC);
+    SSC->SSC_IDR = SSC_IDR_RXRDY;
+#else
+    while (!ssc_read_ready_p (ssc))
+        continue;
+#endif
+}
+
+
+/* Wait until the transmitter can accept data.  */
+static inline void
+ssc_write_wait (ssc_t ssc)
+{
+#if MCU_IDLE_WAIT
+    if (ssc_write_ready_p (ssc))
+        return;
+
+    SSC->SSC_IER = SSC_IER_TXRDY;
+    MCU_WAIT_UNTIL (ssc_write_ready_p (ssc), ID_SSC);
+    SSC->SSC_IDR = SSC_IDR_TXRDY;
+#else
+    while (!ssc_write_ready_p (ssc))
+        continue;
+#endif
+}
+
+
 /* Read data from the rx buffer.  */
 static uint32_t
 ssc_read_8 (ssc_t ssc, void *buffer, uint32_t length)
@@ -357,8 +394,7 @@ ssc_read_8 (ssc_t ssc, void *buffer, uint32_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
         *dst++ = ssc_read_value (ssc);
     }
     return length;
@@ -374,8 +410,7 @@ ssc_read_16 (ssc_t ssc, void *buffer, uint32_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
         *dst++ = ssc_read_value (ssc);
     }
     return length << 1;
@@ -391,8 +426,7 @@ ssc_read_32 (ssc_t ssc, void *buffer, uint32_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
         *dst++ = ssc_read_value (ssc);
     }
     return length << 2;
@@ -421,8 +455,7 @@ ssc_read_32_unpack_int16_sum (ssc_t ssc, int32_t *buffer, uint32_t length)
     {
         int32_t val;
 
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
 
         val = ssc_read_value (ssc);
         *buffer++ += val >> 16;
@@ -441,8 +474,7 @@ ssc_read_16_add (ssc_t ssc, int32_t *buffer, uint32_t length)
     {
         int16_t val;
 
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
 
         val = ssc_read_value (ssc);
         *buffer++ += val;
@@ -460,8 +492,7 @@ ssc_read_16_subtract (ssc_t ssc, int32_t *buffer, uint32_t length)
     {
         int16_t val;
 
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
 
         val = ssc_read_value (ssc);
         *buffer++ -= val;
@@ -477,8 +508,7 @@ ssc_read_ignore (ssc_t ssc, uint32_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_read_ready_p (ssc))
-            continue;
+        ssc_read_wait (ssc);
 
         ssc_read_value (ssc);
     }
@@ -495,8 +525,7 @@ ssc_write_8 (ssc_t ssc, void *buffer, uint16_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_write_ready_p (ssc))
-            continue;
+        ssc_write_wait (ssc);
         SSC->SSC_THR = *src++;
     }
     return length;
@@ -512,8 +541,7 @@ ssc_write_16 (ssc_t ssc, void *buffer, uint16_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_write_ready_p (ssc))
-            continue;
+        ssc_write_wait (ssc);
         SSC->SSC_THR = *src++;
     }
     return length << 1;
@@ -529,8 +557,7 @@ ssc_write_32 (ssc_t ssc, void *buffer, uint16_t length)
 
     for (i = 0; i < length; i++)
     {
-        while (!ssc_write_ready_p (ssc))
-            continue;
+        ssc_write_wait (ssc);
         SSC->SSC_THR = *src++;
     }
     return length << 2;
@@ -589,6 +616,9 @@ ssc_shutdown (ssc_t ssc)
     pio_config_set (TD_PIO, PIO_OUTPUT_LOW);
     pio_config_set (TK_PIO, PIO_OUTPUT_LOW);
     pio_config_set (TF_PIO, PIO_OUTPUT_LOW);
+
+    /* Disable the peripheral clock.  */
+    mcu_pmc_release (ID_SSC);
 }
 
 
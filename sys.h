@@ -25,6 +25,50 @@ typedef int (*sys_unlink_t) (void *fs, const char *pathname);
 typedef int (*sys_rename_t) (void *fs, const char *oldpathname,
                              const char *newpathname);
 
+/* Return the subset of the SYS_POLL_IN and SYS_POLL_OUT events that
+   are ready without blocking.  */
+typedef int (*sys_poll_t) (void *file, int events);
+
+/* Asynchronous I/O request.  The buffer must remain valid and the
+   request must not be modified until it has completed.  */
+typedef struct sys_aio_struct sys_aio_t;
+
+/* Function called when an asynchronous request completes.  This may
+   be called from an interrupt handler.  */
+typedef void (*sys_aio_callback_t) (sys_aio_t *aio);
+
+struct sys_aio_struct
+{
+    void *buffer;
+    size_t size;
+    sys_aio_callback_t callback;
+    /* User data for the callback.  */
+    void *arg;
+    /* The following are set on completion.  The result is the number
+       of bytes transferred or -1 with the error number in error.  */
+    volatile ssize_t result;
+    volatile int error;
+    volatile bool done;
+};
+
+/* Start an asynchronous read or write.  Return -1 and set errno if
+   the request cannot be started, otherwise the driver calls
+   sys_aio_complete when the transfer finishes.  */
+typedef int (*sys_aread_t) (void *file, sys_aio_t *aio);
+
+typedef int (*sys_awrite_t) (void *file, sys_aio_t *aio);
+
+/* Function called while waiting for a device.  It is passed the
+   time remaining before the timeout.  */
+typedef void (*sys_wait_hook_t) (uint32_t remaining_us);
+
+/* Function returning a free running count of microseconds.  */
+typedef uint32_t (*sys_micros_t) (void);
+
+/* Function starting a timer that wakes the core after delay_us.  */
+typedef void (*sys_wakeup_t) (uint32_t delay_us);
+
+
 /* Device operations.  */
 typedef struct sys_file_ops_struct
 {
@@ -33,9 +77,32 @@ typedef struct sys_file_ops_struct
     sys_open_t open;
     sys_close_t close;
     sys_lseek_t lseek;
+    sys_poll_t poll;
+    sys_aread_t aread;
+    sys_awrite_t awrite;
 } sys_file_ops_t;
 
 
+/* Poll events.  */
+#define SYS_POLL_IN 1
+#define SYS_POLL_OUT 4
+/* Returned in revents for a bad file descriptor.  */
+#define SYS_POLL_NVAL 32
+
+/* Timeout for sys_poll to wait indefinitely.  */
+#define SYS_POLL_FOREVER UINT32_MAX
+
+
+typedef struct sys_pollfd_struct
+{
+    int fd;
+    /* Requested events.  */
+    short events;
+    /* Returned events.  */
+    short revents;
+} sys_pollfd_t;
+
+
 typedef struct sys_fs_ops_struct
 {
     /* Function to unlink (delete) a file.  */
@@ -70,14 +137,28 @@ void sys_redirect_stdout (sys_write_t write, void *arg);
 
 void sys_redirect_stderr (sys_write_t write, void *arg);
 
+/** Mount a file system as the root file system.  */
 bool sys_mount (sys_fs_t *fs, int flags);
 
+/** Mount a file system at MOUNTPOINT, say /flash.  The mount point
+    is a single path component; the string is not copied.  Paths
+    starting with the mount point are routed to this file system with
+    the mount point removed; other paths go to the root file system.
+    Return false if the mount point is in use or there are already
+    SYS_FS_NUM file systems mounted.  */
+bool sys_mount_at (sys_fs_t *fs, const char *mountpoint, int flags);
+
+/** Unmount the file system at MOUNTPOINT.  */
+bool sys_unmount (const char *mountpoint);
+
 int sys_attach (sys_file_ops_t *file_ops, void *arg);
 
 
 /** Register a device with a devicename, say /dev/usart0,
     and record the file_ops and arg (say device handle).
-    The device can then be opened using open.  */
+    The device can then be opened using open.  The name is not
+    copied.  The devices are held in a hash table of SYS_DEVICES_NUM
+    entries; return -1 if it is full.  */
 int
 sys_device_register (const char *devicename, const sys_file_ops_t *file_ops,
                      void *arg);
@@ -95,6 +176,121 @@ sys_write_timeout (void *dev, const void *data, size_t size,
                    uint32_t timeout_us, sys_write_t dev_write);
 
 
+/** As sys_read_timeout but for a device that wakes the core when it
+    becomes ready, say by enabling a peripheral interrupt whenever
+    dev_read returns EAGAIN.  If MCU_IDLE_WAIT is non-zero, the core
+    sleeps between polls.  */
+ssize_t
+sys_read_timeout_wake (void *dev, void *data, size_t size,
+                       uint32_t timeout_us, sys_read_t dev_read);
+
+
+/** As sys_write_timeout but for a device that wakes the core.  */
+ssize_t
+sys_write_timeout_wake (void *dev, const void *data, size_t size,
+                        uint32_t timeout_us, sys_write_t dev_write);
+
+
+/** Set function called by sys_read_timeout and sys_write_timeout
+    while waiting for a device, say to sleep until an interrupt.  It
+    should return before the timeout expires.  If MCU_IDLE_WAIT is
+    non-zero, the default for a device that can wake the core is to
+    sleep until an interrupt or for at most SYS_WAIT_POLL_US; other
+    devices are polled without sleeping.  */
+void
+sys_wait_hook_set (sys_wait_hook_t hook);
+
+
+/** Set the time base for the timeouts, say sysclock_micros.  This is
+    set by sysclock_init.  Without it, the timeouts are measured with
+    the cycle counter on the SAM4S, which stops while the core sleeps,
+    so a wait hook should not sleep.  */
+void
+sys_micros_set (sys_micros_t micros);
+
+
+/** Set the function that bounds a sleep while waiting for a device,
+    say sysclock_wakeup.  This is set by sysclock_init.  Without it,
+    the default wait hook does not sleep.  */
+void
+sys_wakeup_set (sys_wakeup_t wakeup);
+
+
+/** Write any characters held in the write buffer for FD to the
+    device.  This has no effect unless SYS_WRITE_BUFFER_SIZE is
+    non-zero.  Return -1 if the device did not accept them all.  */
+int
+sys_flush (int fd);
+
+
+/** Flush write buffers that have held characters for longer than
+    SYS_WRITE_BUFFER_TIMEOUT_MS.  This should be called periodically,
+    say from the main loop, when write buffering is enabled.  On the
+    SAM7, all the write buffers are flushed.  */
+void
+sys_flush_poll (void);
+
+
+/** Wait until one of the NFDS file descriptors in FDS is ready for
+    its requested events or TIMEOUT_US expires.  The ready events are
+    returned in revents.  A file without a poll op is always ready.
+    While waiting, the wait hook is called as for sys_read_timeout; a
+    driver can call sys_event_signal from its interrupt handler to
+    wake the core so the file descriptors are checked again.  Return
+    the number of ready file descriptors, or 0 on timeout.  */
+int
+sys_poll (sys_pollfd_t *fds, unsigned int nfds, uint32_t timeout_us);
+
+
+/** Start an asynchronous read of aio->size bytes into aio->buffer.
+    If the device does not support asynchronous I/O, the read is
+    performed synchronously and the request has completed on return.
+    Return -1 if the request could not be started.  */
+int
+sys_aread (int fd, sys_aio_t *aio);
+
+
+/** Start an asynchronous write of aio->size bytes from aio->buffer.
+    Any characters held in the write buffer are flushed first.  */
+int
+sys_awrite (int fd, sys_aio_t *aio);
+
+
+/** Return true if the asynchronous request has completed.  */
+bool
+sys_aio_done_p (sys_aio_t *aio);
+
+
+/** Wait for an asynchronous request to complete.  Return the number of
+    bytes transferred, or -1 with errno set to ETIMEDOUT if the request
+    has not completed by the timeout.  */
+ssize_t
+sys_aio_wait (sys_aio_t *aio, uint32_t timeout_us);
+
+
+/** Complete an asynchronous request.  This is called by device
+    drivers, usually from an interrupt handler.  */
+void
+sys_aio_complete (sys_aio_t *aio, ssize_t result, int error);
+
+
+/** Return the current end of the heap.  */
+void *
+sys_heap_end_get (void);
+
+
+/** Return the largest heap size in bytes since reset.  */
+size_t
+sys_heap_high_water_get (void);
+
+
+/** Signal that a device may be ready.  This can be called from a
+    driver interrupt handler; it wakes the core if it is sleeping in
+    WFE and stops the next wait.  */
+void
+sys_event_signal (void);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,6 +9,7 @@
 
 #include "config.h"
 #include "delay.h"
+#include "mcu.h"
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -27,28 +28,77 @@
 #define SYS_FD_NUM (SYS_FILE_NUM + 3)
 
 
-/* Maximum number of file systems.  */
+/* Maximum number of mounted file systems.  */
 #ifndef SYS_FS_NUM
 #define SYS_FS_NUM 1
 #endif
 
 
+/* Size of the device table.  This must be a power of 2 and should be
+   at least twice the number of registered devices to keep the probe
+   sequences short.  */
+#ifndef SYS_DEVICES_NUM
+#define SYS_DEVICES_NUM 16
+#endif
+
+
+/* Size of the write-combining buffer for each file descriptor.  Small
+   writes are collected and passed to the device write op as a single
+   span.  Zero disables buffering.  */
+#ifndef SYS_WRITE_BUFFER_SIZE
+#define SYS_WRITE_BUFFER_SIZE 0
+#endif
+
+
+/* Non-zero to flush the write buffer when a newline is written.  */
+#ifndef SYS_WRITE_BUFFER_LINE
+#define SYS_WRITE_BUFFER_LINE 1
+#endif
+
+
+/* Time after the first buffered character that sys_flush_poll
+   flushes the write buffer.  */
+#ifndef SYS_WRITE_BUFFER_TIMEOUT_MS
+#define SYS_WRITE_BUFFER_TIMEOUT_MS 10
+#endif
+
+
 typedef struct sys_file_struct
 {
     sys_file_ops_t *file_ops;
     void *file;
+#if SYS_WRITE_BUFFER_SIZE
+    uint16_t write_count;
+    /* Time when the first character was buffered, see
+       sys_write_time.  */
+    uint32_t write_time;
+    char write_buffer[SYS_WRITE_BUFFER_SIZE];
+#endif
 } sys_file_t;
 
 
 typedef struct sys_device_struct
 {
     const char *name;
+    uint32_t hash;
     sys_file_ops_t *file_ops;
     void *arg;
-    struct sys_device_struct *next;
 } sys_device_t;
 
 
+/* A mount point is the root, /, or a single path component, say
+   /flash.  The hash of the component is compared first so that a
+   path is routed without comparing strings for the other mount
+   points.  */
+typedef struct sys_mount_struct
+{
+    const char *prefix;
+    uint32_t hash;
+    uint8_t len;
+    sys_fs_t *fs;
+} sys_mount_t;
+
+
 static sys_file_ops_t stdin_file_ops;
 static sys_file_ops_t stdout_file_ops;
 static sys_file_ops_t stderr_file_ops;
@@ -61,15 +111,18 @@ static sys_file_t sys_files[SYS_FD_NUM] =
     {.file_ops = &stderr_file_ops, .file = 0}
 };
 
-/* Linked list of devices.  */
-static sys_device_t *sys_devices = 0;
+/* Hash table of devices using open addressing.  */
+static sys_device_t sys_devices[SYS_DEVICES_NUM];
 
-/* Array of file systems.  */
-static sys_fs_t *sys_fs[SYS_FS_NUM];
+/* Table of mounted file systems.  */
+static sys_mount_t sys_mounts[SYS_FS_NUM];
 
 static void (*stdio_putc) (void *stream, int ch) = 0;
 static int (*stdio_getc) (void *stream) = 0;
 
+/* Microsecond time base, see sys_micros_set.  */
+static sys_micros_t sys_micros;
+
 /** Start of heap.  */
 extern char _heap_start__;
 
@@ -127,9 +180,154 @@ stdio_redirect (void (*putc1) (void *stream, int ch),
 }
 
 
+#if SYS_WRITE_BUFFER_SIZE
+/* Pass the buffered characters to the device write op.  The device
+   may accept fewer characters than offered; the remainder is
+   retained.  */
+static int
+sys_write_flush (sys_file_t *file)
+{
+    const char *buffer = file->write_buffer;
+    size_t left = file->write_count;
+
+    while (left)
+    {
+        ssize_t ret;
+
+        ret = file->file_ops->write (file->file, buffer, left);
+        if (ret <= 0)
+        {
+            memmove (file->write_buffer, buffer, left);
+            file->write_count = left;
+            if (ret == 0)
+                errno = EAGAIN;
+            return -1;
+        }
+        buffer += ret;
+        left -= ret;
+    }
+    file->write_count = 0;
+    return 0;
+}
+
+
+/* Return the time in microseconds if there is a microsecond time
+   base.  Otherwise return the cycle counter; this wraps and stops
+   while the CPU sleeps so it is only a fallback.  */
+static uint32_t
+sys_write_time (void)
+{
+    if (sys_micros)
+        return sys_micros ();
+#ifdef __SAM4S__
+    return cpu_cycle_counter_get ();
+#else
+    return 0;
+#endif
+}
+
+
+/* Return non-zero if the first buffered character is older than
+   SYS_WRITE_BUFFER_TIMEOUT_MS.  */
+static bool
+sys_write_expired_p (sys_file_t *file)
+{
+    uint32_t age;
+
+    age = sys_write_time () - file->write_time;
+    if (sys_micros)
+        return age >= SYS_WRITE_BUFFER_TIMEOUT_MS * 1000;
+#ifdef __SAM4S__
+    /* The cycle counter rate follows mcu_clock_set.  */
+    return age >= SYS_WRITE_BUFFER_TIMEOUT_MS * (mcu_clock_get () / 1000);
+#else
+    return 1;
+#endif
+}
+
+
+static ssize_t
+sys_write_buffered (sys_file_t *file, const char *buffer, size_t size)
+{
+    size_t count;
+
+    /* Large writes bypass the buffer if there is nothing to combine
+       them with.  */
+    if (!file->write_count && size >= SYS_WRITE_BUFFER_SIZE)
+        return file->file_ops->write (file->file, buffer, size);
+
+    count = 0;
+    while (count < size)
+    {
+        size_t num;
+        bool flush;
+
+        num = SYS_WRITE_BUFFER_SIZE - file->write_count;
+        if (num > size - count)
+            num = size - count;
+
+        if (!file->write_count)
+            file->write_time = sys_write_time ();
+
+        memcpy (file->write_buffer + file->write_count, buffer + count, num);
+        file->write_count += num;
+
+        flush = file->write_count == SYS_WRITE_BUFFER_SIZE
+            || (SYS_WRITE_BUFFER_LINE && memchr (buffer + count, '\n', num));
+        count += num;
+
+        /* The characters are retained in the buffer if the device is
+           not ready so they have still been written.  */
+        if (flush && sys_write_flush (file) < 0)
+            return count ? (ssize_t)count : -1;
+    }
+    return count;
+}
+#endif
+
+
+int
+sys_flush (int fd)
+{
+    if (fd < 0 || fd >= SYS_FD_NUM || !sys_files[fd].file_ops)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+#if SYS_WRITE_BUFFER_SIZE
+    if (sys_files[fd].write_count)
+        return sys_write_flush (&sys_files[fd]);
+#endif
+    return 0;
+}
+
+
+void
+sys_flush_poll (void)
+{
+#if SYS_WRITE_BUFFER_SIZE
+    int fd;
+
+    for (fd = 0; fd < SYS_FD_NUM; fd++)
+    {
+        sys_file_t *file = &sys_files[fd];
+
+        if (!file->file_ops || !file->write_count)
+            continue;
+
+        if (!sys_write_expired_p (file))
+            continue;
+        sys_write_flush (file);
+    }
+#endif
+}
+
+
 void
 sys_redirect (unsigned int fd, sys_read_t read1, sys_write_t write1, void *arg)
 {
+    sys_flush (fd);
     if (read1)
         sys_files[fd].file_ops->read = read1;
     if (write1)
@@ -159,18 +357,70 @@ sys_redirect_stderr (sys_write_t write1, void *arg)
 }
 
 
+/* FNV-1a hash of the first LEN characters of STR or up to the
+   terminating null.  */
+static uint32_t
+sys_hash (const char *str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    while (len-- && *str)
+    {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/* Find the file system for PATHNAME and return the path relative to
+   its mount point.  A path that does not start with a mount point is
+   on the root file system.  */
 static const char *
 sys_fs_find (const char *pathname, sys_fs_t **pfs)
 {
-    /* TODO, map pathname to a fs.  For now assume that first file
-       system is mounted as /.  */
+    const char *component;
+    const char *end;
+    size_t len;
+    uint32_t hash;
+    sys_fs_t *root;
+    int i;
+
+    component = pathname;
+    if (*component == '/')
+        component++;
+
+    end = strchr (component, '/');
+    len = end ? (size_t)(end - component) : strlen (component);
+    hash = sys_hash (component, len);
+
+    root = 0;
+    for (i = 0; i < SYS_FS_NUM; i++)
+    {
+        sys_mount_t *mount = &sys_mounts[i];
+
+        if (!mount->fs)
+            continue;
 
-    *pfs = sys_fs[0];
+        if (!mount->len)
+        {
+            root = mount->fs;
+            continue;
+        }
 
-    if (*pathname == '/')
-        return pathname + 1;
+        if (mount->hash == hash && mount->len == len
+            && strncmp (mount->prefix, component, len) == 0)
+        {
+            *pfs = mount->fs;
+            component += len;
+            if (*component == '/')
+                component++;
+            return component;
+        }
+    }
 
-    return pathname;
+    *pfs = root;
+    return component;
 }
 
 
@@ -183,6 +433,14 @@ _read (int fd, char *buffer, size_t size)
         return -1;
     }
 
+    /* Make sure that a prompt is seen before waiting for a reply.  */
+    if (fd == 0)
+    {
+        sys_flush (1);
+        sys_flush (2);
+    }
+    sys_flush (fd);
+
     return sys_files[fd].file_ops->read (sys_files[fd].file, buffer, size);
 }
 
@@ -196,6 +454,8 @@ _lseek (int fd, off_t offset, int whence)
         return -1;
     }
 
+    sys_flush (fd);
+
     return sys_files[fd].file_ops->lseek (sys_files[fd].file, offset, whence);
 }
 
@@ -209,7 +469,11 @@ _write (int fd, char *buffer, size_t size)
         return -1;
     }
 
+#if SYS_WRITE_BUFFER_SIZE
+    return sys_write_buffered (&sys_files[fd], buffer, size);
+#else
     return sys_files[fd].file_ops->write (sys_files[fd].file, buffer, size);
+#endif
 }
 
 
@@ -281,20 +545,44 @@ sys_attach (sys_file_ops_t *file_ops, void *arg)
 }
 
 
+/* Return the device table entry for NAME.  This is either the
+   registered device or the empty entry where it would be
+   registered.  Return 0 if NAME is not registered and the table is
+   full.  */
+static sys_device_t *
+sys_device_find (const char *name, uint32_t hash)
+{
+    unsigned int i;
+    unsigned int index;
+
+    index = hash;
+    for (i = 0; i < SYS_DEVICES_NUM; i++, index++)
+    {
+        sys_device_t *device = &sys_devices[index % SYS_DEVICES_NUM];
+
+        if (!device->name)
+            return device;
+
+        if (device->hash == hash && strcmp (device->name, name) == 0)
+            return device;
+    }
+    return 0;
+}
+
+
 static int
 sys_device_open (const char *pathname, int flags)
 {
     sys_device_t *device;
 
-    /* Traverse list of devices.  */
-    for (device = sys_devices; device; device = device->next)
+    device = sys_device_find (pathname, sys_hash (pathname, SIZE_MAX));
+    if (!device || !device->name)
     {
-        if (strcmp (device->name, pathname) == 0)
-            return sys_attach (device->file_ops, device->arg);
+        /* No device found.  */
+        errno = ENXIO;
+        return -1;
     }
-    /* No device found.  */
-    errno = ENXIO;
-    return -1;
+    return sys_attach (device->file_ops, device->arg);
 }
 
 
@@ -321,6 +609,13 @@ _close (int fd)
         return -1;
     }
 
+    sys_flush (fd);
+#if SYS_WRITE_BUFFER_SIZE
+    /* Discard anything the device would not accept so that it is not
+       written to the next file opened with this descriptor.  */
+    sys_files[fd].write_count = 0;
+#endif
+
     ret = sys_files[fd].file_ops->close (sys_files[fd].file);
 
     sys_files[fd].file_ops = 0;
@@ -351,14 +646,19 @@ _getpid (int n __UNUSED__)
 }
 
 
+/* Defined by the linker.  */
+extern char end __asm ("end");
+
+static char *heap_end;
+
+static size_t heap_high_water;
+
+
 caddr_t
 _sbrk (int incr)
 {
-    /* Defined by the linker.  */
-    extern char end __asm ("end");
    /* Register name faking using collusion with the linker.  */
     register char *stack_ptr __asm ("sp");
-    static char *heap_end;
     char *prev_heap_end;
 
     if (heap_end == 0)
@@ -374,10 +674,27 @@ _sbrk (int incr)
 
     heap_end += incr;
 
+    if ((size_t)(heap_end - &end) > heap_high_water)
+        heap_high_water = heap_end - &end;
+
     return (caddr_t) prev_heap_end;
 }
 
 
+void *
+sys_heap_end_get (void)
+{
+    return heap_end ? heap_end : &end;
+}
+
+
+size_t
+sys_heap_high_water_get (void)
+{
+    return heap_high_water;
+}
+
+
 int
 _fstat (int fd __UNUSED__, void *st __UNUSED__)
 {
@@ -405,7 +722,6 @@ _unlink (const char *pathname)
 
     pathname = sys_fs_find (pathname, &fs);
 
-    /* TODO: select fs based on pathname.  */
     if (!fs || !fs->fs_ops || !fs->fs_ops->unlink)
     {
         errno = EACCES;
@@ -451,37 +767,104 @@ _system (const char *s __UNUSED__)
 
 
 int
-_rename (const char *oldpath __UNUSED__, const char *newpath __UNUSED__)
+_rename (const char *oldpath, const char *newpath)
 {
-    /* TODO: Vector to fs op.  Note, both pathnames must be on the
-       same file system otherwise need to return EXDEV.  */
+    sys_fs_t *fs;
+    sys_fs_t *newfs;
 
-    errno = ENOSYS;
-    return -1;
+    oldpath = sys_fs_find (oldpath, &fs);
+    newpath = sys_fs_find (newpath, &newfs);
+
+    /* Both pathnames must be on the same file system.  */
+    if (fs != newfs)
+    {
+        errno = EXDEV;
+        return -1;
+    }
+
+    if (!fs || !fs->fs_ops || !fs->fs_ops->rename)
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    return fs->fs_ops->rename (fs->handle, oldpath, newpath);
 }
 
 
-/* Mount a file system for file I/O.  */
+/* Mount a file system for file I/O at MOUNTPOINT.  */
 bool
-sys_mount (sys_fs_t *fs, int flags)
+sys_mount_at (sys_fs_t *fs, const char *mountpoint, int flags)
 {
+    sys_mount_t *slot;
+    size_t len;
     int i;
 
+    if (*mountpoint == '/')
+        mountpoint++;
+
+    /* Only a single path component is supported.  */
+    len = strlen (mountpoint);
+    if (strchr (mountpoint, '/') || len > UINT8_MAX)
+        return 0;
+
+    slot = 0;
     for (i = 0; i < SYS_FS_NUM; i++)
     {
-        if (!sys_fs[i])
-            break;
+        sys_mount_t *mount = &sys_mounts[i];
+
+        if (!mount->fs)
+        {
+            if (!slot)
+                slot = mount;
+            continue;
+        }
+
+        if (mount->len == len && strcmp (mount->prefix, mountpoint) == 0)
+            return 0;
     }
 
-    if (i == SYS_FS_NUM)
+    if (!slot)
         return 0;
 
-    sys_fs[i] = fs;
-    sys_fs[i]->flags = flags;
+    slot->prefix = mountpoint;
+    slot->len = len;
+    slot->hash = sys_hash (mountpoint, len);
+    slot->fs = fs;
+    fs->flags = flags;
     return 1;
 }
 
 
+/* Mount a file system for file I/O as the root file system.  */
+bool
+sys_mount (sys_fs_t *fs, int flags)
+{
+    return sys_mount_at (fs, "/", flags);
+}
+
+
+bool
+sys_unmount (const char *mountpoint)
+{
+    int i;
+
+    if (*mountpoint == '/')
+        mountpoint++;
+
+    for (i = 0; i < SYS_FS_NUM; i++)
+    {
+        sys_mount_t *mount = &sys_mounts[i];
+
+        if (mount->fs && strcmp (mount->prefix, mountpoint) == 0)
+        {
+            mount->fs = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
 /** Register a device with a devicename, say /dev/usart0,
     and record the file_ops and arg (say device handle).
     The device can then be opened using open.  */
@@ -490,43 +873,420 @@ sys_device_register (const char *devicename, const sys_file_ops_t *file_ops,
                      void *arg)
 {
     sys_device_t *device;
-    sys_device_t *new;
+    uint32_t hash;
+
+    hash = sys_hash (devicename, SIZE_MAX);
+
+    /* A device that is already registered is updated.  */
+    device = sys_device_find (devicename, hash);
+    if (!device)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
 
-    new = malloc (sizeof (*new));
-    new->name = devicename;
-    new->file_ops = (void *)file_ops;
-    new->arg = arg;
-    new->next = 0;
+    device->name = devicename;
+    device->hash = hash;
+    device->file_ops = (void *)file_ops;
+    device->arg = arg;
 
-    if (! sys_devices)
+    return 0;
+}
+
+/* Timeouts are measured by accumulating the elapsed ticks every time
+   the device is polled so that the timeout can be longer than the
+   wrap period of the counter.  The time base is, in order of
+   preference:
+
+   1. The microsecond count set with sys_micros_set, say by sysclock.
+   This keeps counting while the core sleeps.
+
+   2. On the SAM4S, the cycle counter.  This stops while the core
+   sleeps so the default wait hook does not sleep.
+
+   3. On the SAM7, the PIT counter.  This wraps every PIT period so
+   the device must be polled more often than this.  If the PIT is not
+   enabled, it is started with the longest period (0.35 s at
+   48 MHz).
+
+   With MCU_IDLE_WAIT, the default wait hook only sleeps for devices
+   that can wake the core (see sys_read_timeout_wake).  A timer set
+   with sys_wakeup_set bounds each sleep to SYS_WAIT_POLL_US or the
+   time remaining, less SYS_WAIT_MARGIN_US, whichever is less.  The
+   rest of the timeout is polled so that it is not overrun.  */
+
+/* Longest sleep before the device is polled again.  */
+#ifndef SYS_WAIT_POLL_US
+#define SYS_WAIT_POLL_US 10000
+#endif
+
+/* Time before the timeout expires when the wait stops sleeping.  This
+   allows for the resolution of the wakeup timer (1 ms with sysclock
+   unless it is tickless).  */
+#ifndef SYS_WAIT_MARGIN_US
+#define SYS_WAIT_MARGIN_US 1000
+#endif
+
+
+typedef struct sys_timeout_struct
+{
+    /* Non-zero if the device wakes the core when it is ready.  */
+    bool wake;
+    sys_micros_t micros;
+    /* Ticks per second.  */
+    uint32_t rate;
+    uint32_t last;
+    uint64_t elapsed;
+    uint64_t deadline;
+} sys_timeout_t;
+
+
+static sys_wakeup_t sys_wakeup;
+
+static sys_wait_hook_t sys_wait_hook;
+
+static volatile bool sys_event_flag;
+
+
+#if MCU_IDLE_WAIT
+/* Sleep until an interrupt or event, say from the device or the
+   wakeup timer.  The time asleep is only measured if there is a
+   microsecond time base.  */
+static void
+sys_wait_idle (uint32_t remaining_us)
+{
+    uint32_t delay_us;
+
+    if (!sys_micros || !sys_wakeup || remaining_us <= SYS_WAIT_MARGIN_US)
+        return;
+
+    delay_us = remaining_us - SYS_WAIT_MARGIN_US;
+    if (delay_us > SYS_WAIT_POLL_US)
+        delay_us = SYS_WAIT_POLL_US;
+
+    sys_wakeup (delay_us);
+    cpu_wfe ();
+}
+#endif
+
+
+void
+sys_wait_hook_set (sys_wait_hook_t hook)
+{
+    sys_wait_hook = hook;
+}
+
+
+void
+sys_micros_set (sys_micros_t micros)
+{
+    sys_micros = micros;
+}
+
+
+void
+sys_wakeup_set (sys_wakeup_t wakeup)
+{
+    sys_wakeup = wakeup;
+}
+
+
+void
+sys_event_signal (void)
+{
+    sys_event_flag = 1;
+#ifdef __SAM4S__
+    cpu_sev ();
+#endif
+}
+
+
+/* Return the number of ticks since the last call.  */
+static uint32_t
+sys_timeout_ticks (sys_timeout_t *timeout)
+{
+    uint32_t now;
+    uint32_t ticks;
+
+    if (timeout->micros)
+    {
+        now = timeout->micros ();
+        ticks = now - timeout->last;
+    }
+    else
+    {
+#ifdef __SAM4S__
+        now = cpu_cycle_counter_get ();
+        ticks = now - timeout->last;
+#else
+        uint32_t period;
+
+        period = (AT91C_BASE_PITC->PITC_PIMR & AT91C_PITC_PIV) + 1;
+        now = AT91C_BASE_PITC->PITC_PIIR & AT91C_PITC_CPIV;
+        ticks = now >= timeout->last ? now - timeout->last
+            : now + period - timeout->last;
+#endif
+    }
+    timeout->last = now;
+    return ticks;
+}
+
+
+static void
+sys_timeout_start (sys_timeout_t *timeout, uint32_t timeout_us)
+{
+    timeout->micros = sys_micros;
+    timeout->elapsed = 0;
+
+    if (timeout->micros)
     {
-        sys_devices = new;
+        timeout->rate = 1000000;
+        timeout->last = timeout->micros ();
     }
     else
     {
-        /* Traverse list of devices.  */
-        for (device = sys_devices; device->next; device = device->next)
+#ifdef __SAM4S__
+        /* The cycle counter rate follows mcu_clock_set.  */
+        timeout->rate = mcu_clock_get ();
+        timeout->last = cpu_cycle_counter_get ();
+#else
+        if (!(AT91C_BASE_PITC->PITC_PIMR & AT91C_PITC_PITEN))
+            AT91C_BASE_PITC->PITC_PIMR = AT91C_PITC_PIV | AT91C_PITC_PITEN;
+
+        /* The PIT is clocked at MCK / 16.  */
+        timeout->rate = mcu_clock_get () / 16;
+        timeout->last = AT91C_BASE_PITC->PITC_PIIR & AT91C_PITC_CPIV;
+#endif
+    }
+
+    timeout->deadline = (uint64_t)timeout_us * timeout->rate / 1000000;
+}
+
+
+/* Wait before polling the device again.  Return false if the timeout
+   has expired.  */
+static bool
+sys_timeout_wait (sys_timeout_t *timeout)
+{
+    uint32_t remaining_us;
+    sys_wait_hook_t hook;
+
+    timeout->elapsed += sys_timeout_ticks (timeout);
+    if (timeout->elapsed >= timeout->deadline)
+        return 0;
+    remaining_us = (timeout->deadline - timeout->elapsed) * 1000000
+        / timeout->rate;
+
+    /* Don't wait if a driver has signalled that a device may be
+       ready.  */
+    if (sys_event_flag)
+    {
+        sys_event_flag = 0;
+        return 1;
+    }
+
+    hook = sys_wait_hook;
+#if MCU_IDLE_WAIT
+    if (!hook && timeout->wake)
+        hook = sys_wait_idle;
+#endif
+    if (hook)
+        hook (remaining_us);
+    return 1;
+}
+
+
+static int
+sys_poll_check (sys_pollfd_t *fds, unsigned int nfds)
+{
+    unsigned int i;
+    int ready;
+
+    ready = 0;
+    for (i = 0; i < nfds; i++)
+    {
+        sys_pollfd_t *pollfd = &fds[i];
+        sys_file_t *file;
+
+        pollfd->revents = 0;
+
+        if (pollfd->fd < 0)
+            continue;
+
+        if (pollfd->fd >= SYS_FD_NUM || !sys_files[pollfd->fd].file_ops)
         {
-            /* Perhaps check if device already registered?  */
+            pollfd->revents = SYS_POLL_NVAL;
+            ready++;
             continue;
         }
-        device->next = new;
+
+        file = &sys_files[pollfd->fd];
+        if (file->file_ops->poll)
+            pollfd->revents = file->file_ops->poll (file->file,
+                                                    pollfd->events);
+        else
+            pollfd->revents = pollfd->events;
+
+        pollfd->revents &= pollfd->events;
+        if (pollfd->revents)
+            ready++;
+    }
+    return ready;
+}
+
+
+int
+sys_poll (sys_pollfd_t *fds, unsigned int nfds, uint32_t timeout_us)
+{
+    sys_timeout_t timeout;
+    int ready;
+
+    /* The devices may not be able to wake the core so the default
+       wait hook does not sleep.  */
+    timeout.wake = 0;
+    sys_timeout_start (&timeout, timeout_us);
+
+    while (1)
+    {
+        ready = sys_poll_check (fds, nfds);
+        if (ready)
+            return ready;
+
+        if (!sys_timeout_wait (&timeout))
+        {
+            if (timeout_us != SYS_POLL_FOREVER)
+                return 0;
+            sys_timeout_start (&timeout, timeout_us);
+        }
+    }
+}
+
+
+void
+sys_aio_complete (sys_aio_t *aio, ssize_t result, int error)
+{
+    aio->result = result;
+    aio->error = result < 0 ? error : 0;
+    aio->done = 1;
+
+    /* Wake anything waiting in sys_aio_wait or sys_poll.  */
+    sys_event_signal ();
+
+    if (aio->callback)
+        aio->callback (aio);
+}
+
+
+static sys_file_t *
+sys_aio_file (int fd, sys_aio_t *aio)
+{
+    if (fd < 0 || fd >= SYS_FD_NUM || !sys_files[fd].file_ops)
+    {
+        errno = EBADF;
+        return 0;
     }
 
+    aio->result = 0;
+    aio->error = 0;
+    aio->done = 0;
+    return &sys_files[fd];
+}
+
+
+int
+sys_aread (int fd, sys_aio_t *aio)
+{
+    sys_file_t *file;
+    ssize_t ret;
+
+    file = sys_aio_file (fd, aio);
+    if (!file)
+        return -1;
+
+    if (file->file_ops->aread && aio->size)
+        return file->file_ops->aread (file->file, aio);
+
+    /* Fall back to a synchronous read.  */
+    ret = aio->size ? _read (fd, aio->buffer, aio->size) : 0;
+    sys_aio_complete (aio, ret, errno);
     return 0;
 }
 
 
+int
+sys_awrite (int fd, sys_aio_t *aio)
+{
+    sys_file_t *file;
+    ssize_t ret;
+
+    file = sys_aio_file (fd, aio);
+    if (!file)
+        return -1;
+
+    /* Keep the order of the buffered and asynchronous writes.  */
+    if (sys_flush (fd) < 0)
+        return -1;
+
+    if (file->file_ops->awrite && aio->size)
+        return file->file_ops->awrite (file->file, aio);
+
+    /* Fall back to a synchronous write.  This bypasses the write
+       buffer since the data is already in a single span.  */
+    ret = -1;
+    errno = ENODEV;
+    if (file->file_ops->write)
+        ret = aio->size ? file->file_ops->write (file->file, aio->buffer,
+                                                 aio->size) : 0;
+    sys_aio_complete (aio, ret, errno);
+    return 0;
+}
+
+
+bool
+sys_aio_done_p (sys_aio_t *aio)
+{
+    return aio->done;
+}
+
+
+ssize_t
+sys_aio_wait (sys_aio_t *aio, uint32_t timeout_us)
+{
+    sys_timeout_t timeout;
+
+    /* The driver calls sys_aio_complete from its interrupt handler,
+       which wakes the core.  */
+    timeout.wake = 1;
+    sys_timeout_start (&timeout, timeout_us);
+
+    while (!aio->done)
+    {
+        if (!sys_timeout_wait (&timeout))
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    if (aio->result < 0)
+        errno = aio->error;
+    return aio->result;
+}
+
+
 /* Helper read function for device drivers.  The timeout is reset for
    every read without fail.  */
-ssize_t
-sys_read_timeout (void *dev, void *data, size_t size,
-                  uint32_t timeout_us, sys_read_t dev_read)
+static ssize_t
+sys_read_wait (void *dev, void *data, size_t size,
+               uint32_t timeout_us, sys_read_t dev_read, bool wake)
 {
     uint8_t *buffer = data;
     size_t left;
     size_t count;
-    uint32_t timeout = timeout_us;
+    sys_timeout_t timeout;
+
+    timeout.wake = wake;
+    sys_timeout_start (&timeout, timeout_us);
 
     count = 0;
     left = size;
@@ -540,32 +1300,49 @@ sys_read_timeout (void *dev, void *data, size_t size,
         {
             if (errno != EAGAIN)
                 return ret;
-            if (timeout_us == 0)
+            if (!sys_timeout_wait (&timeout))
                 return ret;
-            timeout_us--;
-            DELAY_US (1);
             continue;
         }
 
         count += ret;
         left -= ret;
         buffer += ret;
-        timeout = timeout_us;
+        sys_timeout_start (&timeout, timeout_us);
     }
     return count;
 }
 
 
+ssize_t
+sys_read_timeout (void *dev, void *data, size_t size,
+                  uint32_t timeout_us, sys_read_t dev_read)
+{
+    return sys_read_wait (dev, data, size, timeout_us, dev_read, 0);
+}
+
+
+ssize_t
+sys_read_timeout_wake (void *dev, void *data, size_t size,
+                       uint32_t timeout_us, sys_read_t dev_read)
+{
+    return sys_read_wait (dev, data, size, timeout_us, dev_read, 1);
+}
+
+
 /* Helper write function for device drivers.  The timeout is reset for
    every write without fail.  */
-ssize_t
-sys_write_timeout (void *dev, const void *data, size_t size,
-                   uint32_t timeout_us, sys_write_t dev_write)
+static ssize_t
+sys_write_wait (void *dev, const void *data, size_t size,
+                uint32_t timeout_us, sys_write_t dev_write, bool wake)
 {
     const uint8_t *buffer = data;
     size_t left;
     size_t count;
-    uint32_t timeout = timeout_us;
+    sys_timeout_t timeout;
+
+    timeout.wake = wake;
+    sys_timeout_start (&timeout, timeout_us);
 
     count = 0;
     left = size;
@@ -579,17 +1356,31 @@ sys_write_timeout (void *dev, const void *data, size_t size,
         {
             if (errno != EAGAIN)
                 return ret;
-            if (timeout_us == 0)
+            if (!sys_timeout_wait (&timeout))
                 return ret;
-            timeout_us--;
-            DELAY_US (1);
             continue;
         }
 
         count += ret;
         left -= ret;
         buffer += ret;
-        timeout = timeout_us;
+        sys_timeout_start (&timeout, timeout_us);
     }
     return count;
 }
+
+
+ssize_t
+sys_write_timeout (void *dev, const void *data, size_t size,
+                   uint32_t timeout_us, sys_write_t dev_write)
+{
+    return sys_write_wait (dev, data, size, timeout_us, dev_write, 0);
+}
+
+
+ssize_t
+sys_write_timeout_wake (void *dev, const void *data, size_t size,
+                        uint32_t timeout_us, sys_write_t dev_write)
+{
+    return sys_write_wait (dev, data, size, timeout_us, dev_write, 1);
+}
@@ -39,6 +39,11 @@
 #define TC_CHANNEL(TC) ((TC) - tc_devices)
 
 
+#ifndef TC_IRQ_PRIORITY
+#define TC_IRQ_PRIORITY 7
+#endif
+
+
 #ifdef __SAM4S__
 #define TC_BASE (TC0)
 #define TC0_BASE (TC0->TC_CHANNEL)
@@ -159,6 +164,7 @@ tc_counter_get (tc_t tc)
 {
     tc_counter_t overflows;
     uint16_t counter_value;
+    irq_state_t irq_state;
 
     /* Unfortunately the hardware counter is only 16 bits.  We try to
        synthesise a 64 bit counter by counting overflows.  The
@@ -166,15 +172,17 @@ tc_counter_get (tc_t tc)
 
        The first is due to non-atomic reading of the 64 bit
        tc->overflows.  This is avoided by reading tc->overflows in a
-       critical section.
+       critical section.  Only the interrupts with the TC priority or
+       lower are masked.
 
        The second is due to the non-atomic reading of the counter
        value and reading of the status register to determine an
        overflow.  This could be avoided by pausing the counter but
        this will drop counts every time this function is read.  */
 
-    /* Disable interrupts to ensure that reading tc->overflows is atomic.  */
-    irq_global_disable ();
+    /* Mask TC interrupts to ensure that reading tc->overflows is
+       atomic.  */
+    irq_state = irq_critical_enter (TC_IRQ_PRIORITY);
     overflows = tc->overflows;
 
     /* Read counter value.  */
@@ -195,13 +203,14 @@ tc_counter_get (tc_t tc)
 
            Case 3.  Another interrupt handler has hogged the CPU
            for at least half the counter rollover period.   This
-           is avoided by globally disabling interrupts.
+           is avoided for lower priority handlers by the critical
+           section; higher priority handlers must be short.
         */
         if (counter_value < 32768)
             overflows++;
     }
 
-    irq_global_enable ();
+    irq_critical_exit (irq_state);
 
     return (overflows << 16) | counter_value;
 }
@@ -211,11 +220,12 @@ tc_counter_t
 tc_capture_get (tc_t tc, tc_capture_t reg)
 {
     tc_counter_t ret = 0;
+    irq_state_t irq_state;
 
     /* It might be better to have a ring buffer where capture events
        are pushed.  This will avoid the use of a critical section.  */
 
-    irq_global_disable ();
+    irq_state = irq_critical_enter (TC_IRQ_PRIORITY);
 
     switch (reg)
     {
@@ -230,7 +240,7 @@ tc_capture_get (tc_t tc, tc_capture_t reg)
         break;
     }
 
-    irq_global_enable ();
+    irq_critical_exit (irq_state);
     return ret;
 }
 
@@ -420,13 +430,50 @@ tc_frequency_t
 tc_frequency_set (tc_t tc, tc_frequency_t frequency)
 {
     tc_period_t period;
+    uint32_t f_clock;
 
-    period = TC_PERIOD_DIVISOR (frequency, tc->prescale);
+    f_clock = mcu_clock_get () / tc->prescale;
+    period = (f_clock + frequency / 2) / frequency;
 
     period = tc_period_set (tc, period);
     tc_delay_set (tc, period >> 1);
 
-    return TC_CLOCK_FREQUENCY (tc->prescale) / period;
+    return f_clock / period;
+}
+
+
+static tc_period_t
+tc_period_scale (tc_period_t period, uint32_t f_new, uint32_t f_old)
+{
+    uint32_t scaled;
+
+    scaled = ((uint64_t)period * f_new + f_old / 2) / f_old;
+    if (scaled > 0xffff)
+        scaled = 0xffff;
+    return scaled;
+}
+
+
+/* Scale the period and delays when MCK changes so that the output
+   waveform timing is maintained.  In capture mode, the captured
+   values are in clocks of the new MCK.  */
+static void
+tc_clock_notify (void *arg, mcu_clock_event_t event, uint32_t f_mck)
+{
+    tc_t tc = arg;
+    uint32_t f_old;
+
+    if (event != MCU_CLOCK_CHANGE_POST)
+        return;
+
+    f_old = tc->f_mck;
+    tc->f_mck = f_mck;
+    if (!f_old || f_old == f_mck)
+        return;
+
+    tc_period_set (tc, tc_period_scale (tc->period, f_mck, f_old));
+    tc_delay_set (tc, tc_period_scale (tc->delay, f_mck, f_old));
+    tc_aux_delay_set (tc, tc_period_scale (tc->aux_delay, f_mck, f_old));
 }
 
 
@@ -688,6 +735,9 @@ tc_config_set (tc_t tc, const tc_cfg_t *cfg)
         && cfg->prescale != 0)
         return TC_ERROR_PRESCALE;
 
+    /* The period and delays are in clocks of the current MCK.  */
+    tc->f_mck = mcu_clock_get ();
+
     if (cfg->frequency)
     {
         tc_frequency_set (tc, cfg->frequency);
@@ -707,7 +757,11 @@ void
 tc_shutdown (tc_t tc)
 {
     /* Disable peripheral clock.  */
-    mcu_pmc_disable (ID_TC0 + TC_CHANNEL (tc));
+    if (tc->active)
+    {
+        mcu_pmc_release (ID_TC0 + TC_CHANNEL (tc));
+        tc->active = 0;
+    }
 
     irq_disable (ID_TC0 + TC_CHANNEL (tc));
 
@@ -739,25 +793,34 @@ tc_init (const tc_cfg_t *cfg)
     {
     case TC_CHANNEL_0:
         tc->base = TC0_BASE;
-        irq_config (ID_TC0, 7, tc_handler0);
+        irq_config (ID_TC0, TC_IRQ_PRIORITY, tc_handler0);
         break;
 
     case TC_CHANNEL_1:
         tc->base = TC1_BASE;
-        irq_config (ID_TC1, 7, tc_handler1);
+        irq_config (ID_TC1, TC_IRQ_PRIORITY, tc_handler1);
         break;
 
     case TC_CHANNEL_2:
         tc->base = TC2_BASE;
-        irq_config (ID_TC2, 7, tc_handler2);
+        irq_config (ID_TC2, TC_IRQ_PRIORITY, tc_handler2);
         break;
     }
 
-    /* Enable TCx peripheral clock.  */
-    mcu_pmc_enable (ID_TC0 + pin->channel);
+    /* Enable TCx peripheral clock.  Only take a reference on the
+       first call so that the TC can be reconfigured by calling this
+       again.  */
+    if (! tc->active)
+    {
+        mcu_pmc_acquire (ID_TC0 + pin->channel);
+        tc->active = 1;
+    }
 
     tc_config_set (tc, cfg);
 
+    if (! mcu_clock_notify_register (tc_clock_notify, tc))
+        return 0;
+
     /* Configure output pins if applicable.  */
     tc_output_set (tc);
     tc_aux_output_set (tc);
@@ -795,7 +858,7 @@ tc_clock_sync (tc_t tc, tc_period_t period)
 
     id = ID_TC0 + TC_CHANNEL (tc);
 
-    irq_config (id, 7, tc_clock_sync_handler);
+    irq_config (id, TC_IRQ_PRIORITY, tc_clock_sync_handler);
 
     irq_enable (id);
 
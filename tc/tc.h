@@ -18,6 +18,8 @@ extern "C" {
 #include "config.h"
 #include "pio.h"
 
+/* These assume MCK is F_CPU.  If MCK is changed by mcu_clock_set, the
+   period and delays are scaled to maintain the output timing.  */
 #define TC_CLOCK_FREQUENCY(PRESCALE) (F_CPU / (PRESCALE))
 
 #define TC_PERIOD_DIVISOR(FREQ, PRESCALE) ((tc_period_t)(0.5 + TC_CLOCK_FREQUENCY (PRESCALE) / (FREQ)))
@@ -26,7 +26,11 @@ typedef struct
     tc_period_t delay;          /* Clocks */
     tc_period_t aux_delay;      /* Clocks */
     tc_prescale_t prescale;
+    /* MCK frequency that the period and delays are computed for.  */
+    uint32_t f_mck;
     int capture_state;
+    /* Non-zero if the peripheral clock reference is held.  */
+    bool active;
 } tc_dev_t;
 
 
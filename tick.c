@@ -1,16 +1,307 @@
 /** @file   tick.c
     @author M. P. Hayes, UCECE
     @date   15 May 2007
-    @brief 
+    @brief  Paced loop scheduler.
 */
 #include "pit.h"
 #include "tick.h"
+#include "irq.h"
+#include "mcu.h"
+
+
+/* The tick interrupt increments a tick count that is used to detect
+   missed ticks.  On the SAM7, the PIT interrupt adds the picture
+   count (PICNT) of the number of periods since PIVR was last read.
+   The SAM4S PIT is replaced by SysTick so the SysTick interrupt
+   increments the count.  This allows the CPU to sleep until the next
+   tick.  On the SAM7, the PIT shares the system interrupt with the
+   other system peripherals so its vector is taken over by tick_init.
+
+   The start time of each task after the tick is measured from the
+   PIT or SysTick counter.  On the SAM4S, the execution time of each
+   task is measured with the cycle counter.  */
+
+
+#ifndef TICK_IRQ_PRIORITY
+#ifdef __SAM7__
+#define TICK_IRQ_PRIORITY 0
+#else
+#define TICK_IRQ_PRIORITY 15
+#endif
+#endif
+
+
+typedef struct tick_task_dev_struct
+{
+    tick_task_t func;
+    void *arg;
+    uint16_t divider;
+    uint16_t phase;
+    tick_task_stats_t stats;
+} tick_task_dev_t;
+
+
+typedef struct tick_dev_struct
+{
+    /* Number of ticks.  */
+    volatile uint32_t count;
+#ifdef __SAM4S__
+    /* MCK that the SysTick period was set for.  */
+    uint32_t f_mck;
+#endif
+    /* Tick count at last tick_wait.  */
+    uint32_t last;
+    uint32_t overruns;
+    uint8_t tasks_num;
+    tick_task_dev_t tasks[TICK_TASKS_NUM];
+} tick_dev_t;
+
+
+static tick_dev_t tick_dev;
+
+
+#ifdef __SAM7__
+#define TICK_PICNT_SHIFT 20
+
+
+/* Return the time since the last tick in CPU clocks.  */
+static inline uint32_t
+tick_offset_get (void)
+{
+    return (AT91C_BASE_PITC->PITC_PIIR & 0xfffff) * TICK_CLOCK_DIVISOR;
+}
+
+
+static void
+tick_handler (void)
+{
+    /* Reading PIVR resets the picture count and clears the
+       interrupt.  */
+    if (AT91C_BASE_PITC->PITC_PISR & AT91C_PITC_PITS)
+        tick_dev.count += AT91C_BASE_PITC->PITC_PIVR >> TICK_PICNT_SHIFT;
+}
+
+
+/* The processor clock is restarted by a pending interrupt even when
+   the CPU has interrupts masked.  */
+#define TICK_IDLE() mcu_cpu_idle ()
+
+#else
+
+static inline uint32_t
+tick_offset_get (void)
+{
+    return pit_get ();
+}
+
+
+static void
+tick_handler (void)
+{
+    tick_dev.count++;
+}
+
+
+/* Scale the SysTick period when MCK is changed by mcu_clock_set so
+   that the tick rate is unchanged.  */
+static void
+tick_clock_notify (void *arg, mcu_clock_event_t event, uint32_t f_mck)
+{
+    uint32_t period;
+
+    if (event != MCU_CLOCK_CHANGE_POST)
+        return;
+
+    period = (uint64_t)(SysTick->LOAD + 1) * f_mck / tick_dev.f_mck;
+    tick_dev.f_mck = f_mck;
+    pit_period_set (period - 1);
+    SysTick->VAL = 0;
+}
+
+
+#define TICK_IDLE() cpu_wfi ()
+#endif
+
+
+uint32_t
+tick_wait (void)
+{
+    uint32_t count;
+    uint32_t missed;
+    irq_state_t irq_state;
+
+    /* Mask interrupts while checking the count so that the tick
+       cannot occur between the check and the sleep.  The pending tick
+       still wakes the CPU.  */
+    while (1)
+    {
+        irq_state = irq_global_save ();
+        count = tick_dev.count;
+        if (count != tick_dev.last)
+            break;
+        TICK_IDLE ();
+        irq_global_restore (irq_state);
+    }
+    irq_global_restore (irq_state);
+
+    missed = count - tick_dev.last - 1;
+    tick_dev.last = count;
+    tick_dev.overruns += missed;
+    return missed;
+}
+
+
+void
+tick_tasks_run (void)
+{
+    uint32_t count;
+    unsigned int i;
+
+    count = tick_dev.count;
+
+    for (i = 0; i < tick_dev.tasks_num; i++)
+    {
+        tick_task_dev_t *task = &tick_dev.tasks[i];
+        tick_task_stats_t *stats = &task->stats;
+        uint32_t offset;
+
+        if ((count + task->divider - task->phase) % task->divider)
+            continue;
+
+        offset = tick_offset_get ();
+        if (offset < stats->start_min)
+            stats->start_min = offset;
+        if (offset > stats->start_max)
+            stats->start_max = offset;
+
+#ifdef __SAM4S__
+        {
+            uint32_t start;
+            uint32_t duration;
+
+            start = cpu_cycle_counter_get ();
+            task->func (task->arg);
+            duration = cpu_cycle_counter_get () - start;
+
+            stats->duration_total += duration;
+            if (duration > stats->duration_max)
+                stats->duration_max = duration;
+        }
+#else
+        task->func (task->arg);
+#endif
+        stats->runs++;
+    }
+}
+
 
 void
+tick_run (void)
+{
+    while (1)
+    {
+        tick_wait ();
+        tick_tasks_run ();
+    }
+}
+
+
+int
+tick_task_add (tick_task_t func, void *arg, uint16_t divider, uint16_t phase)
+{
+    tick_task_dev_t *task;
+
+    if (tick_dev.tasks_num >= TICK_TASKS_NUM)
+        return -1;
+
+    task = &tick_dev.tasks[tick_dev.tasks_num];
+    task->func = func;
+    task->arg = arg;
+    task->divider = divider ? divider : 1;
+    task->phase = phase % task->divider;
+    task->stats.runs = 0;
+    task->stats.duration_max = 0;
+    task->stats.duration_total = 0;
+    task->stats.start_min = ~0u;
+    task->stats.start_max = 0;
+
+    return tick_dev.tasks_num++;
+}
+
+
+bool
+tick_task_stats_get (int task, tick_task_stats_t *stats)
+{
+    if (task < 0 || task >= tick_dev.tasks_num)
+        return 0;
+
+    *stats = tick_dev.tasks[task].stats;
+    return 1;
+}
+
+
+void
+tick_stats_reset (void)
+{
+    unsigned int i;
+
+    for (i = 0; i < tick_dev.tasks_num; i++)
+    {
+        tick_task_stats_t *stats = &tick_dev.tasks[i].stats;
+
+        stats->runs = 0;
+        stats->duration_max = 0;
+        stats->duration_total = 0;
+        stats->start_min = ~0u;
+        stats->start_max = 0;
+    }
+    tick_dev.overruns = 0;
+}
+
+
+uint32_t
+tick_count_get (void)
+{
+    return tick_dev.count;
+}
+
+
+uint32_t
+tick_overruns_get (void)
+{
+    return tick_dev.overruns;
+}
+
+
+bool
 tick_init (uint32_t divisor)
 {
-    /* Initialise timer 2 for paced loop.  */
+    /* Initialise PIT for paced loop.  */
     pit_init ();
-    pit_period_set (divisor);
-    pit_start ();
+    pit_period_set (divisor - 1);
+
+    tick_dev.count = 0;
+    tick_dev.last = 0;
+    tick_dev.overruns = 0;
+
+#ifdef __SAM7__
+    /* Clear the picture count.  */
+    AT91C_BASE_PITC->PITC_PIVR;
+    irq_config (AT91C_ID_SYS, TICK_IRQ_PRIORITY, tick_handler);
+    AT91C_BASE_PITC->PITC_PIMR |= AT91C_PITC_PITIEN;
+    irq_enable (AT91C_ID_SYS);
+#else
+    /* Restart the count.  */
+    SysTick->VAL = 0;
+    irq_config (SysTick_IRQn, TICK_IRQ_PRIORITY, tick_handler);
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+
+    /* TICK_DIVISOR assumes that MCK is F_CPU.  */
+    tick_dev.f_mck = F_CPU;
+    if (mcu_clock_get () != F_CPU)
+        tick_clock_notify (0, MCU_CLOCK_CHANGE_POST, mcu_clock_get ());
+    if (!mcu_clock_notify_register (tick_clock_notify, 0))
+        return 0;
+#endif
+    return 1;
 }
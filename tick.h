@@ -1,7 +1,12 @@
 /** @file   tick.h
     @author M. P. Hayes, UCECE
     @date   3 June 2007
-    @brief 
+    @brief  Paced loop scheduler.
+    @note   The tick is generated by the PIT on the SAM7 and by
+    SysTick on the SAM4S (which thus cannot be used by sysclock).
+    Tasks are run at the tick rate divided by a specified divider.
+    Ticks that are missed because the tasks took too long are counted
+    as overruns.
 */
 #ifndef TICK_H
 #define TICK_H
@@ -14,42 +19,99 @@ extern "C" {
 #include "config.h"
 #include "pit.h"
 
-#define TICK_RATE_MIN (F_CPU / 16 / (1 << 20))
+
+#ifdef __SAM7__
+/* The PIT is clocked at MCK / 16 and has a 20 bit period.  */
+#define TICK_CLOCK_DIVISOR 16
+#define TICK_PERIOD_MAX (1 << 20)
+#else
+/* SysTick is clocked at MCK and has a 24 bit period.  */
+#define TICK_CLOCK_DIVISOR 1
+#define TICK_PERIOD_MAX (1 << 24)
+#endif
+
+#define TICK_RATE_MIN (F_CPU / TICK_CLOCK_DIVISOR / TICK_PERIOD_MAX)
 
 /* This macro is used to avoid run-time division.  */
-#define TICK_DIVISOR(FREQ) PIT_DIVISOR (FREQ)
+#define TICK_DIVISOR(FREQ) ((uint32_t)(F_CPU / TICK_CLOCK_DIVISOR / (FREQ)))
+
+
+/* Maximum number of tasks.  */
+#ifndef TICK_TASKS_NUM
+#define TICK_TASKS_NUM 8
+#endif
 
-#define TICK_READY_P() PIT_COMPARE_P ()
 
-#define TICK_WAIT() while (!TICK_READY_P ()) continue
+typedef void (*tick_task_t) (void *arg);
 
-#define TICK_RESET() PIT_RESET()
 
-#define TICK_INT_ENABLE() PIT_INT_ENABLE()
+typedef struct tick_task_stats_struct
+{
+    /* Number of times the task has run.  */
+    uint32_t runs;
+    /* Longest execution time in CPU clocks (SAM4S only).  */
+    uint32_t duration_max;
+    /* Total execution time in CPU clocks (SAM4S only).  */
+    uint64_t duration_total;
+    /* Earliest and latest start time after the tick in CPU clocks.
+       The difference is the jitter.  */
+    uint32_t start_min;
+    uint32_t start_max;
+} tick_task_stats_t;
+
+
+/** Initialise tick with period of divisor PIT ticks, see
+    TICK_DIVISOR.  Return zero if the clock notifier cannot be
+    registered.  */
+extern bool
+tick_init (uint32_t divisor);
 
-#define TICK_INT_DISABLE() PIT_INT_DISABLE()
 
-//#define TICK_INTERRUPT SIG_OUTPUT_COMPARE2
+/** Add task to be run every divider ticks, starting at the tick
+    number given by phase (modulo divider).  The phase can be used to
+    spread tasks over the ticks.  Return task number or -1 if there
+    are too many tasks.  */
+int
+tick_task_add (tick_task_t func, void *arg, uint16_t divider, uint16_t phase);
 
 
-#if 0
-#define TICK_SLEEP() \
-do {set_sleep_mode (SLEEP_MODE_IDLE); sleep_mode ();} while (0)
-#endif
+/** Sleep until the next tick.  Return the number of ticks missed
+    since the previous call.  */
+uint32_t
+tick_wait (void);
 
-extern void
-tick_init (uint32_t divisor);
 
+/** Run the tasks due for the current tick.  */
+void
+tick_tasks_run (void);
+
+
+/** Wait for each tick and run the tasks.  This does not return.  */
+void
+tick_run (void);
+
+
+/** Return the number of ticks since initialisation.  */
+uint32_t
+tick_count_get (void);
+
+
+/** Return the total number of missed ticks.  */
+uint32_t
+tick_overruns_get (void);
+
+
+/** Get the statistics for a task.  */
+bool
+tick_task_stats_get (int task, tick_task_stats_t *stats);
+
+
+/** Reset the statistics for all the tasks.  */
+void
+tick_stats_reset (void);
 
-static inline void
-tick_wait (void)
-{
-    /* Wait for next clock tick.  */
-    TICK_WAIT ();
-}
 
 #ifdef __cplusplus
 }
 #endif    
 #endif
-
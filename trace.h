@@ -13,9 +13,110 @@ extern "C" {
     
 #endif
 
+/* Non-zero to record TRACE_PRINTF calls in a binary trace buffer
+   instead of formatting them.  This needs trace/trace.mk.  */
+#ifndef TRACE_BINARY
+#define TRACE_BINARY 0
+#endif
+
+
+/* Number of 32-bit words in the trace buffer.  This must be a power
+   of 2.  */
+#ifndef TRACE_BUFFER_WORDS
+#define TRACE_BUFFER_WORDS 1024
+#endif
+
+
+/* Maximum number of arguments for a trace point.  */
+#define TRACE_ARGS_MAX 4
+
+
+/* Each trace point is recorded in the buffer as the words:
+
+   header, format, timestamp, arg0, ..., argN-1
+
+   The header is TRACE_HEADER_MAGIC ORed with the number of words in
+   the record and is written last.  The format is the address of the
+   format string so a host tool can look it up in the ELF file.  The
+   timestamp is the CPU cycle counter on the SAM4S.  Since only the
+   raw arguments are recorded, they must be integers or pointers; a
+   string argument is recorded as its address.  */
+#define TRACE_HEADER_MAGIC 0xa5000000
+#define TRACE_HEADER_WORDS_MASK 0xff
+
+
+typedef struct trace_record_struct
+{
+    const char *format;
+    uint32_t timestamp;
+    uint8_t nargs;
+    uint32_t args[TRACE_ARGS_MAX];
+} trace_record_t;
+
+
+/** Record a trace point.  This is usually called via TRACE_LOG.  It
+    does not block and can be called from any interrupt priority.  The
+    record is dropped if the buffer is full.  */
+void
+trace_log (const char *format, unsigned int nargs,
+           uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+
+/** Remove the oldest record from the trace buffer.  Return false if
+    there are no committed records.  There must only be a single
+    reader.  */
+bool
+trace_drain (trace_record_t *record);
+
+
+/** Format a record into BUFFER of SIZE bytes.  Return the number of
+    characters as for snprintf.  */
+int
+trace_decode (const trace_record_t *record, char *buffer, size_t size);
+
+
+/** Drain and print all the records to stderr, say in idle time.
+    Return the number of records printed.  */
+unsigned int
+trace_dump (void);
+
+
+/** Return the number of records dropped since the buffer was full.  */
+uint32_t
+trace_dropped_get (void);
+
+
+#define TRACE_NARGS(...) TRACE_NARGS_ (0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define TRACE_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+
+#define TRACE_LOG_N(N, FMT, ...) TRACE_LOG_N_ (N, FMT, ##__VA_ARGS__)
+#define TRACE_LOG_N_(N, FMT, ...) TRACE_LOG ## N (FMT, ##__VA_ARGS__)
+
+#define TRACE_LOG0(FMT) \
+    trace_log (FMT, 0, 0, 0, 0, 0)
+#define TRACE_LOG1(FMT, A) \
+    trace_log (FMT, 1, (uint32_t)(A), 0, 0, 0)
+#define TRACE_LOG2(FMT, A, B) \
+    trace_log (FMT, 2, (uint32_t)(A), (uint32_t)(B), 0, 0)
+#define TRACE_LOG3(FMT, A, B, C) \
+    trace_log (FMT, 3, (uint32_t)(A), (uint32_t)(B), (uint32_t)(C), 0)
+#define TRACE_LOG4(FMT, A, B, C, D) \
+    trace_log (FMT, 4, (uint32_t)(A), (uint32_t)(B), (uint32_t)(C), \
+               (uint32_t)(D))
+
+/** Record a trace point with a constant format string and up to
+    TRACE_ARGS_MAX integer arguments.  */
+#define TRACE_LOG(FMT, ...) \
+    TRACE_LOG_N (TRACE_NARGS (__VA_ARGS__), FMT, ##__VA_ARGS__)
+
+
 #ifndef TRACE_PRINTF
+#if TRACE_BINARY
+#define TRACE_PRINTF(...) TRACE_LOG (__VA_ARGS__)
+#else
 #define TRACE_PRINTF(...) fprintf (stderr, __VA_ARGS__)
 #endif
+#endif
 
 #define TRACE_INFO(THING, ...) TRACE_ ## THING ## _INFO (__VA_ARGS__)
 
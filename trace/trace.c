@@ -0,0 +1,210 @@
+/** @file   trace.c
+    @author M. P. Hayes, UCECE
+    @date   18 October 2026
+    @brief  Binary trace buffer.
+*/
+
+#include <stdio.h>
+#include "trace.h"
+#include "irq.h"
+#include "cpu.h"
+
+
+/* The trace buffer is a ring of words.  A writer claims space by
+   advancing trace_write_index, fills in the record, and then writes
+   the header to commit it.  Since a writer can be preempted by
+   another, records may be committed out of order; the reader stops at
+   the first record that is not committed.  The reader clears the
+   words of each record it removes so that a zero header always means
+   not committed.
+
+   The buffer is not static so that a debugger or host tool can read
+   it using the symbol trace_buffer.  */
+uint32_t trace_buffer[TRACE_BUFFER_WORDS];
+
+static volatile uint32_t trace_write_index;
+static volatile uint32_t trace_read_index;
+static volatile uint32_t trace_dropped;
+
+
+#define TRACE_INDEX(INDEX) ((INDEX) & (TRACE_BUFFER_WORDS - 1))
+
+/* The CPU is a single core so the commit only needs to be ordered
+   with respect to interrupts.  */
+#define TRACE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+
+static void
+trace_dropped_inc (void)
+{
+#ifdef __SAM4S__
+    uint32_t dropped;
+
+    do
+    {
+        dropped = __LDREXW (&trace_dropped);
+    } while (__STREXW (dropped + 1, &trace_dropped));
+#else
+    irq_state_t irq_state;
+
+    irq_state = irq_global_save ();
+    trace_dropped++;
+    irq_global_restore (irq_state);
+#endif
+}
+
+
+/* Claim WORDS words of the buffer.  Return false if there is not
+   enough space.  */
+static bool
+trace_claim (uint32_t words, uint32_t *pindex)
+{
+    uint32_t index;
+
+#ifdef __SAM4S__
+    do
+    {
+        index = __LDREXW (&trace_write_index);
+        if (index + words - trace_read_index > TRACE_BUFFER_WORDS)
+        {
+            __CLREX ();
+            return 0;
+        }
+    } while (__STREXW (index + words, &trace_write_index));
+#else
+    irq_state_t irq_state;
+
+    irq_state = irq_global_save ();
+    index = trace_write_index;
+    if (index + words - trace_read_index > TRACE_BUFFER_WORDS)
+    {
+        irq_global_restore (irq_state);
+        return 0;
+    }
+    trace_write_index = index + words;
+    irq_global_restore (irq_state);
+#endif
+
+    *pindex = index;
+    return 1;
+}
+
+
+void
+trace_log (const char *format, unsigned int nargs,
+           uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    uint32_t index;
+    uint32_t words;
+    uint32_t timestamp;
+
+#ifdef __SAM4S__
+    timestamp = cpu_cycle_counter_get ();
+#else
+    timestamp = 0;
+#endif
+
+    if (nargs > TRACE_ARGS_MAX)
+        nargs = TRACE_ARGS_MAX;
+    words = 3 + nargs;
+
+    if (!trace_claim (words, &index))
+    {
+        trace_dropped_inc ();
+        return;
+    }
+
+    trace_buffer[TRACE_INDEX (index + 1)] = (uint32_t)format;
+    trace_buffer[TRACE_INDEX (index + 2)] = timestamp;
+
+    switch (nargs)
+    {
+    case 4:
+        trace_buffer[TRACE_INDEX (index + 6)] = arg3;
+        /* Fall through.  */
+    case 3:
+        trace_buffer[TRACE_INDEX (index + 5)] = arg2;
+        /* Fall through.  */
+    case 2:
+        trace_buffer[TRACE_INDEX (index + 4)] = arg1;
+        /* Fall through.  */
+    case 1:
+        trace_buffer[TRACE_INDEX (index + 3)] = arg0;
+        /* Fall through.  */
+    default:
+        break;
+    }
+
+    TRACE_BARRIER ();
+    trace_buffer[TRACE_INDEX (index)] = TRACE_HEADER_MAGIC | words;
+}
+
+
+bool
+trace_drain (trace_record_t *record)
+{
+    uint32_t index;
+    uint32_t header;
+    uint32_t words;
+    uint32_t i;
+
+    index = trace_read_index;
+    if (index == trace_write_index)
+        return 0;
+
+    header = trace_buffer[TRACE_INDEX (index)];
+    if ((header & ~TRACE_HEADER_WORDS_MASK) != TRACE_HEADER_MAGIC)
+        return 0;
+    TRACE_BARRIER ();
+
+    words = header & TRACE_HEADER_WORDS_MASK;
+    record->format = (const char *)trace_buffer[TRACE_INDEX (index + 1)];
+    record->timestamp = trace_buffer[TRACE_INDEX (index + 2)];
+    record->nargs = words - 3;
+    for (i = 0; i < TRACE_ARGS_MAX; i++)
+    {
+        record->args[i] = i < record->nargs
+            ? trace_buffer[TRACE_INDEX (index + 3 + i)] : 0;
+    }
+
+    for (i = 0; i < words; i++)
+        trace_buffer[TRACE_INDEX (index + i)] = 0;
+
+    /* Only release the space once it has been cleared.  */
+    TRACE_BARRIER ();
+    trace_read_index = index + words;
+    return 1;
+}
+
+
+int
+trace_decode (const trace_record_t *record, char *buffer, size_t size)
+{
+    /* The unused arguments are zero and are ignored by the format.  */
+    return snprintf (buffer, size, record->format, record->args[0],
+                     record->args[1], record->args[2], record->args[3]);
+}
+
+
+unsigned int
+trace_dump (void)
+{
+    trace_record_t record;
+    unsigned int count;
+    char buffer[80];
+
+    for (count = 0; trace_drain (&record); count++)
+    {
+        trace_decode (&record, buffer, sizeof (buffer));
+        fprintf (stderr, "%lu: %s", (unsigned long)record.timestamp,
+                 buffer);
+    }
+    return count;
+}
+
+
+uint32_t
+trace_dropped_get (void)
+{
+    return trace_dropped;
+}
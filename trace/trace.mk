@@ -0,0 +1,6 @@
+TRACE_DIR = $(MAT91LIB_DIR)/trace
+
+VPATH += $(TRACE_DIR)
+INCLUDES += -I$(TRACE_DIR)
+
+SRC += trace.c
@@ -43,6 +43,8 @@
 
 #define TWI_DEVICES_NUM 2
 
+#define TWI_ID(TWI) (ID_TWI0 + (TWI)->channel)
+
 static twi_dev_t twi_devices[TWI_DEVICES_NUM];
 
 
@@ -97,21 +99,42 @@ static void twi_unstick (twi_t twi)
 }
 
 
+/* Record a mode transition.  The clock is needed to detect the slave
+   address so a reference is held while in slave mode.  In master mode
+   the clock is only held for the duration of a transfer.  */
+static void
+twi_mode_set (twi_t twi, twi_mode_t mode)
+{
+    if (mode == twi->mode)
+        return;
+
+    if (mode == TWI_MODE_SLAVE)
+        mcu_pmc_acquire (TWI_ID (twi));
+    else if (twi->mode == TWI_MODE_SLAVE)
+        mcu_pmc_release (TWI_ID (twi));
+
+    twi->mode = mode;
+}
+
+
 void
 twi_reset (twi_t twi)
 {
+    mcu_pmc_acquire (TWI_ID (twi));
+
     /* Dummy read of status register.  */
     twi->base->TWI_SR;
 
     /* Perform software reset of peripheral.  */
     twi->base->TWI_CR = TWI_CR_SWRST;
 
-    /* The controller becomes a master on reset.  */
-    twi->mode = TWI_MODE_MASTER;
-
     /* Clock ony required for master mode.  Set a 50% duty cycle.  */
     twi->base->TWI_CWGR = twi->clock_config;
 
+    /* The controller becomes a master on reset.  */
+    twi_mode_set (twi, TWI_MODE_MASTER);
+    mcu_pmc_release (TWI_ID (twi));
+
     twi_unstick (twi);
 }
 
@@ -133,6 +156,60 @@ static void twi_config (twi_t twi)
 }
 
 
+/* The SCL low and high times are ((CLDIV << CKDIV) + 4) MCK clocks.  */
+#define TWI_CLDIV_MAX 255
+#define TWI_CKDIV_MAX 7
+#define TWI_PERIOD_MIN 4
+#define TWI_PERIOD_MAX ((TWI_CLDIV_MAX << TWI_CKDIV_MAX) + TWI_PERIOD_MIN)
+
+
+static void
+twi_clock_config_set (twi_t twi, uint32_t period)
+{
+    uint32_t div;
+    uint32_t cldiv;
+    uint8_t ckdiv;
+
+    /* Clamp to the range of the clock divisors.  */
+    if (period < TWI_PERIOD_MIN)
+        period = TWI_PERIOD_MIN;
+    if (period > TWI_PERIOD_MAX)
+        period = TWI_PERIOD_MAX;
+    div = period - TWI_PERIOD_MIN;
+
+    /* Use the smallest prescaler and round up so that the SCL
+       frequency is not exceeded.  */
+    for (ckdiv = 0; ; ckdiv++)
+    {
+        cldiv = (div + (1 << ckdiv) - 1) >> ckdiv;
+        if (cldiv <= TWI_CLDIV_MAX)
+            break;
+    }
+
+    twi->clock_config = TWI_CWGR_CLDIV (cldiv)
+        | TWI_CWGR_CHDIV (cldiv)
+        | TWI_CWGR_CKDIV (ckdiv);
+}
+
+
+/* Recompute the clock divisors when MCK changes.  The SCL clock is
+   only used in master mode and the caller must ensure that no
+   transfer is in progress.  */
+static void
+twi_clock_notify (void *arg, mcu_clock_event_t event, uint32_t f_mck)
+{
+    twi_t twi = arg;
+
+    if (event != MCU_CLOCK_CHANGE_POST || !twi->scl_frequency)
+        return;
+
+    twi_clock_config_set (twi, (f_mck / 2) / twi->scl_frequency);
+    mcu_pmc_acquire (TWI_ID (twi));
+    twi->base->TWI_CWGR = twi->clock_config;
+    mcu_pmc_release (TWI_ID (twi));
+}
+
+
 twi_t 
 twi_init (const twi_cfg_t *cfg)
 {
@@ -157,14 +234,17 @@ twi_init (const twi_cfg_t *cfg)
     twi->channel = cfg->channel;
     twi_config (twi);
     
-    /* Enable TWIx peripheral clock.  */
-    mcu_pmc_enable (ID_TWI0 + cfg->channel);
-    
-    twi->clock_config = TWI_CWGR_CLDIV (cfg->period - 4) 
-        | TWI_CWGR_CHDIV (cfg->period - 4)
-        | TWI_CWGR_CKDIV ((cfg->period - 4) >> 8);
+    twi_clock_config_set (twi, cfg->period);
+
+    /* The period is specified in clocks of the current MCK.  */
+    twi->scl_frequency = cfg->period
+        ? (mcu_clock_get () / 2) / cfg->period : 0;
+    if (!mcu_clock_notify_register (twi_clock_notify, twi))
+        return 0;
 
-    /* Reset TWI peripheral.  */
+    /* Reset TWI peripheral.  The TWIx peripheral clock is only
+       enabled for the duration of a master transfer or while in slave
+       mode.  */
     twi_reset (twi);
 
     /* Slave address ony required for slave mode.  */
@@ -183,7 +263,8 @@ twi_master_init (twi_t twi, twi_slave_addr_t slave_addr,
     twi->base->TWI_CR = TWI_CR_SVDIS;
     twi->base->TWI_CR = TWI_CR_MSEN;
 
-    twi->mode = TWI_MODE_MASTER;
+    /* The caller holds the clock for the transfer.  */
+    twi_mode_set (twi, TWI_MODE_MASTER);
 
     /* The flowchart Fig 33-17 suggests this order for MMR and IADR.  */
     twi->base->TWI_MMR = TWI_MMR_DADR (slave_addr)
@@ -240,22 +321,11 @@ twi_master_wait_txcomp (twi_t twi, twi_timeout_t timeout_us)
 }
 
 
-/** Perform a master write to the specified slave address with internal address
-    and timeout
-    @param twi TWI controller to use
-    @param slave_addr 7 bit slave address
-    @param addr optional internal address
-    @param addr_size number of bytes for internal address (0--3)
-    @param buffer buffer to write from
-    @param size number of bytes to transfer
-    @param timeout_us timeout in microseconds
-    @return number of bytes read or negative value for an error
-*/    
-twi_ret_t
-twi_master_addr_write_timeout (twi_t twi, twi_slave_addr_t slave_addr,
-                               twi_iaddr_t addr, uint8_t addr_size,
-                               const void *buffer, twi_size_t size,
-                               twi_timeout_t timeout_us)
+static twi_ret_t
+twi_master_addr_write_transfer (twi_t twi, twi_slave_addr_t slave_addr,
+                                twi_iaddr_t addr, uint8_t addr_size,
+                                const void *buffer, twi_size_t size,
+                                twi_timeout_t timeout_us)
 {
     twi_size_t i;
     const uint8_t *data = buffer;
@@ -307,6 +377,33 @@ twi_master_addr_write_timeout (twi_t twi, twi_slave_addr_t slave_addr,
 }
 
 
+/** Perform a master write to the specified slave address with internal address
+    and timeout
+    @param twi TWI controller to use
+    @param slave_addr 7 bit slave address
+    @param addr optional internal address
+    @param addr_size number of bytes for internal address (0--3)
+    @param buffer buffer to write from
+    @param size number of bytes to transfer
+    @param timeout_us timeout in microseconds
+    @return number of bytes read or negative value for an error
+*/    
+twi_ret_t
+twi_master_addr_write_timeout (twi_t twi, twi_slave_addr_t slave_addr,
+                               twi_iaddr_t addr, uint8_t addr_size,
+                               const void *buffer, twi_size_t size,
+                               twi_timeout_t timeout_us)
+{
+    twi_ret_t ret;
+
+    mcu_pmc_acquire (TWI_ID (twi));
+    ret = twi_master_addr_write_transfer (twi, slave_addr, addr, addr_size,
+                                          buffer, size, timeout_us);
+    mcu_pmc_release (TWI_ID (twi));
+    return ret;
+}
+
+
 /** Perform a master write to the specified slave address with internal address
     and default timeout
     @param twi TWI controller to use
@@ -369,22 +466,11 @@ twi_master_read_wait_ack (twi_t twi, twi_timeout_t timeout_us)
 }
 
 
-/** Perform a master read to the specified slave address   
-    @param twi TWI controller to use
-    @param slave_addr 7 bit slave address
-    @param addr optional internal address
-    @param addr_size number of bytes for internal address (0--3)
-    @param buffer buffer to read into
-    @param size number of bytes to transfer
-    @param timeout_us timeout in microseconds
-    @return number of bytes read or negative value for an error
-    @note If there are more bytes to be read than specified, they will be gobbled
-*/    
-twi_ret_t
-twi_master_addr_read_timeout (twi_t twi, twi_slave_addr_t slave_addr,
-                              twi_iaddr_t addr, uint8_t addr_size,
-                              void *buffer, twi_size_t size,
-                              twi_timeout_t timeout_us)
+static twi_ret_t
+twi_master_addr_read_transfer (twi_t twi, twi_slave_addr_t slave_addr,
+                               twi_iaddr_t addr, uint8_t addr_size,
+                               void *buffer, twi_size_t size,
+                               twi_timeout_t timeout_us)
 {
     twi_size_t i;
     uint8_t *data = buffer;
@@ -434,6 +520,33 @@ twi_master_addr_read_timeout (twi_t twi, twi_slave_addr_t slave_addr,
 }
 
 
+/** Perform a master read to the specified slave address   
+    @param twi TWI controller to use
+    @param slave_addr 7 bit slave address
+    @param addr optional internal address
+    @param addr_size number of bytes for internal address (0--3)
+    @param buffer buffer to read into
+    @param size number of bytes to transfer
+    @param timeout_us timeout in microseconds
+    @return number of bytes read or negative value for an error
+    @note If there are more bytes to be read than specified, they will be gobbled
+*/    
+twi_ret_t
+twi_master_addr_read_timeout (twi_t twi, twi_slave_addr_t slave_addr,
+                              twi_iaddr_t addr, uint8_t addr_size,
+                              void *buffer, twi_size_t size,
+                              twi_timeout_t timeout_us)
+{
+    twi_ret_t ret;
+
+    mcu_pmc_acquire (TWI_ID (twi));
+    ret = twi_master_addr_read_transfer (twi, slave_addr, addr, addr_size,
+                                         buffer, size, timeout_us);
+    mcu_pmc_release (TWI_ID (twi));
+    return ret;
+}
+
+
 /** Perform a master read to the specified slave address   
     @param twi TWI controller to use
     @param slave_addr 7 bit slave address
@@ -475,6 +588,10 @@ twi_master_read (twi_t twi, twi_slave_addr_t slave_addr,
 static twi_ret_t
 twi_slave_init (twi_t twi)
 {
+    /* This holds the clock until the controller is reset or switched
+       to master mode.  */
+    twi_mode_set (twi, TWI_MODE_SLAVE);
+
     /* Must be set before enabling slave mode.  */
     twi->base->TWI_SMR = TWI_MMR_DADR (twi->slave_addr);
 
@@ -483,8 +600,6 @@ twi_slave_init (twi_t twi)
     twi->base->TWI_CR = TWI_CR_SVDIS;
     twi->base->TWI_CR = TWI_CR_SVEN;
 
-    twi->mode = TWI_MODE_SLAVE;
-
     return TWI_OK;
 }
 
@@ -733,16 +848,16 @@ twi_slave_read (twi_t twi, void *buffer, twi_size_t size)
 void
 twi_shutdown (twi_t twi)
 {
+    twi_mode_set (twi, TWI_MODE_MASTER);
+
     if (twi->base == TWI1)
     {
         pio_config_set (TWD1_PIO, PIO_PULLUP);
         pio_config_set (TWCK1_PIO, PIO_PULLUP);
-        mcu_pmc_disable (ID_TWI1);
     }
     else
     {
         pio_config_set (TWD0_PIO, PIO_PULLUP);
         pio_config_set (TWCK0_PIO, PIO_PULLUP);
-        mcu_pmc_disable (ID_TWI0);
     }
 }
@@ -18,6 +18,8 @@ extern "C" {
 #include "pio.h"
 #include "twi_private.h"
 
+/* This assumes MCK is F_CPU.  If MCK is later changed by mcu_clock_set,
+   the divisors are recomputed to maintain the SCL frequency.  */
 #define TWI_PERIOD_DIVISOR(FREQ) ((twi_period_t)((F_CPU / 2) / (FREQ)))
 
 #ifndef TWI_TIMEOUT_US_DEFAULT
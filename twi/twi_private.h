@@ -30,6 +30,8 @@ typedef struct twi_dev_struct
     twi_slave_addr_t slave_addr;
     twi_mode_t mode;
     uint32_t clock_config;
+    /* SCL frequency, used to recompute the clock divisors.  */
+    uint32_t scl_frequency;
     uint8_t channel;
 } twi_dev_t;
 
@@ -52,6 +52,7 @@ buart0_tx_finished_p (void)
 }
 
 
+__ramfunc_if__ (MAT91LIB_RAMFUNC_ISR)
 static void
 buart0_isr (void)
 {
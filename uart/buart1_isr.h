@@ -53,6 +53,7 @@ buart1_tx_finished_p (void)
 }
 
 
+__ramfunc_if__ (MAT91LIB_RAMFUNC_ISR)
 static void
 buart1_isr (void)
 {
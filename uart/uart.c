@@ -5,6 +5,10 @@
 
 #include "uart.h"
 #include "peripherals.h"
+#include "mcu.h"
+#if MCU_IDLE_WAIT
+#include "irq.h"
+#endif
 
 /* This needs updating to be more general and to provide
    support for synchronous operation. 
@@ -25,6 +29,10 @@
 #define UART1_ENABLE (UART_NUM >= 2)
 #endif
 
+#ifndef UART_CLOCK_CHANGE_POLLS
+#define UART_CLOCK_CHANGE_POLLS 100000
+#endif
+
 
 struct uart_dev_struct
 {
@@ -33,8 +41,15 @@ struct uart_dev_struct
     bool (*read_ready_p) (void);
     bool (*write_ready_p) (void);
     bool (*write_finished_p) (void);
+    void (*baud_divisor_set) (uint16_t baud_divisor);
     uint32_t read_timeout_us;
     uint32_t write_timeout_us;    
+    /* Zero if the baud divisor was specified.  */
+    uint32_t baud_rate;
+#if MCU_IDLE_WAIT
+    Uart *base;
+    irq_id_t irq_id;
+#endif
 };
 
 
@@ -44,7 +59,8 @@ struct uart_dev_struct
 
 static uart_dev_t uart0_dev = {uart0_putc, uart0_getc,
                                uart0_read_ready_p, uart0_write_ready_p,
-                               uart0_write_finished_p, 0, 0};
+                               uart0_write_finished_p,
+                               uart0_baud_divisor_set, 0, 0, 0};
 #endif
 
 #if UART1_ENABLE
@@ -52,10 +68,36 @@ static uart_dev_t uart0_dev = {uart0_putc, uart0_getc,
 
 static uart_dev_t uart1_dev = {uart1_putc, uart1_getc,
                                uart1_read_ready_p, uart1_write_ready_p,
-                               uart1_write_finished_p, 0, 0};
+                               uart1_write_finished_p,
+                               uart1_baud_divisor_set, 0, 0, 0};
 #endif
 
 
+/* Recompute the baud rate divisor when MCK changes.  */
+static void
+uart_clock_notify (void *arg, mcu_clock_event_t event, uint32_t f_mck)
+{
+    uart_dev_t *dev = arg;
+    unsigned int i;
+
+    if (!dev->baud_rate)
+        return;
+
+    if (event == MCU_CLOCK_CHANGE_PRE)
+    {
+        /* Let the character being sent finish at the old baud rate.
+           The number of polls is limited in case the transmitter is
+           stalled by flow control.  */
+        for (i = 0; i < UART_CLOCK_CHANGE_POLLS
+                 && !dev->write_finished_p (); i++)
+            continue;
+        return;
+    }
+
+    dev->baud_divisor_set ((f_mck / 16) / dev->baud_rate);
+}
+
+
 uart_t 
 uart_init (const uart_cfg_t *cfg)
 {
@@ -65,13 +107,17 @@ uart_init (const uart_cfg_t *cfg)
     if (cfg->baud_rate == 0)
         baud_divisor = cfg->baud_divisor;
     else
-        baud_divisor = UART_BAUD_DIVISOR (cfg->baud_rate);
+        baud_divisor = (mcu_clock_get () / 16) / cfg->baud_rate;
 
 #if UART0_ENABLE
     if (cfg->channel == 0)
     {
         uart0_init (baud_divisor);
         dev = &uart0_dev;
+#if MCU_IDLE_WAIT
+        dev->base = UART0;
+        dev->irq_id = ID_UART0;
+#endif
     }
 #endif
 
@@ -80,11 +126,19 @@ uart_init (const uart_cfg_t *cfg)
     {
         uart1_init (baud_divisor);
         dev = &uart1_dev;
+#if MCU_IDLE_WAIT
+        dev->base = UART1;
+        dev->irq_id = ID_UART1;
+#endif
     }
 #endif
 
     dev->read_timeout_us = cfg->read_timeout_us;
     dev->write_timeout_us = cfg->write_timeout_us;
+    dev->baud_rate = cfg->baud_rate;
+
+    if (!mcu_clock_notify_register (uart_clock_notify, dev))
+        return 0;
 
     return dev;
 }
@@ -120,6 +174,29 @@ uart_write_finished_p (uart_t uart)
 }
 
 
+/* Enable the peripheral interrupt for MASK so that the device
+   becoming ready wakes the core.  The interrupt is not enabled in the
+   NVIC.  The pending interrupt is cleared before the device is
+   checked; see MCU_WAIT_UNTIL.  */
+static void
+uart_wake_arm (uart_dev_t *dev, uint32_t mask)
+{
+#if MCU_IDLE_WAIT
+    dev->base->UART_IER = mask;
+    irq_clear (dev->irq_id);
+#endif
+}
+
+
+static void
+uart_wake_disarm (uart_dev_t *dev, uint32_t mask)
+{
+#if MCU_IDLE_WAIT
+    dev->base->UART_IDR = mask;
+#endif
+}
+
+
 /** Read size bytes.  */
 static int16_t
 uart_read_nonblock (uart_t uart, void *data, uint16_t size)
@@ -170,15 +247,34 @@ uart_write_nonblock (uart_t uart, const void *data, uint16_t size)
 }
 
 
+static int16_t
+uart_read_wake (uart_t uart, void *data, uint16_t size)
+{
+    uart_wake_arm (uart, UART_IER_RXRDY);
+    return uart_read_nonblock (uart, data, size);
+}
+
+
+static int16_t
+uart_write_wake (uart_t uart, const void *data, uint16_t size)
+{
+    uart_wake_arm (uart, UART_IER_TXRDY);
+    return uart_write_nonblock (uart, data, size);
+}
+
+
 /** Read size bytes.  Block until all the bytes have been read or
     until timeout occurs.  */
 ssize_t
 uart_read (void *uart, void *data, size_t size)
 {
     uart_dev_t *dev = uart;
-    
-    return sys_read_timeout (uart, data, size, dev->read_timeout_us,
-                             (void *)uart_read_nonblock);
+    ssize_t ret;
+
+    ret = sys_read_timeout_wake (uart, data, size, dev->read_timeout_us,
+                                 (void *)uart_read_wake);
+    uart_wake_disarm (dev, UART_IDR_RXRDY);
+    return ret;
 }
 
 
@@ -188,9 +284,12 @@ ssize_t
 uart_write (void *uart, const void *data, size_t size)
 {
     uart_dev_t *dev = uart;
-    
-    return sys_write_timeout (uart, data, size, dev->write_timeout_us,
-                              (void *)uart_write_nonblock);
+    ssize_t ret;
+
+    ret = sys_write_timeout_wake (uart, data, size, dev->write_timeout_us,
+                                  (void *)uart_write_wake);
+    uart_wake_disarm (dev, UART_IDR_TXRDY);
+    return ret;
 }
 
 
@@ -237,8 +336,23 @@ uart_puts (uart_t uart, const char *str)
     return 1;
 }
 
+
+static int
+uart_poll (void *uart, int events)
+{
+    int revents = 0;
+
+    if ((events & SYS_POLL_IN) && uart_read_ready_p (uart))
+        revents |= SYS_POLL_IN;
+    if ((events & SYS_POLL_OUT) && uart_write_ready_p (uart))
+        revents |= SYS_POLL_OUT;
+    return revents;
+}
+
+
 const sys_file_ops_t uart_file_ops =
 {
     .read = (void *)uart_read,
-    .write = (void *)uart_write
+    .write = (void *)uart_write,
+    .poll = uart_poll
 };
@@ -19,7 +19,8 @@ typedef struct
 {
     /* 0 for UART0, 1 for UART1.  */
     uint8_t channel;
-    /* Baud rate.  */
+    /* Baud rate.  The divisor is recomputed if MCK is changed by
+       mcu_clock_set.  */
     uint32_t baud_rate;
     /* Baud rate divisor (this is used if baud_rate is zero).  */
     uint32_t baud_divisor;
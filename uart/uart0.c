@@ -10,6 +10,10 @@
 #include "uart0_defs.h"
 
 
+/* Non-zero if the clock reference is held.  */
+static bool uart0_active;
+
+
 void
 uart0_baud_divisor_set (uint16_t baud_divisor)
 {
@@ -27,8 +31,13 @@ uart0_init (uint16_t baud_divisor)
     pio_config_set (UTXD0_PIO, UTXD0_PERIPH);
     pio_config_set (URXD0_PIO, URXD0_PERIPH);
 
-    /* Enable UART0 clock.  */
-    mcu_pmc_enable (ID_UART0);
+    /* Enable UART0 clock.  Only take a reference on the first call so
+       that the baud rate can be changed by calling this again.  */
+    if (! uart0_active)
+    {
+        mcu_pmc_acquire (ID_UART0);
+        uart0_active = 1;
+    }
 
     /* Reset and disable receiver and transmitter.  */
     UART0->UART_CR = UART_CR_RSTRX | UART_CR_RSTTX
@@ -57,7 +66,11 @@ uart0_shutdown (void)
     pio_config_set (URXD0_PIO, PIO_OUTPUT_LOW);
 
     /* Disable UART0 clock.  */
-    mcu_pmc_disable (ID_UART0);
+    if (uart0_active)
+    {
+        mcu_pmc_release (ID_UART0);
+        uart0_active = 0;
+    }
 
     /* Reset and disable receiver and transmitter.  */
     UART0->UART_CR = UART_CR_RSTRX | UART_CR_RSTTX
@@ -38,6 +38,10 @@ uart0_write_finished_p (void);
 int
 uart0_putc (char ch);
 
+/* Set baud rate divisor.  */
+void
+uart0_baud_divisor_set (uint16_t baud_divisor);
+
 /* Initialise UART0 and set baud rate.  */
 int
 uart0_init (uint16_t baud_divisor);
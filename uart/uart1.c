@@ -10,6 +10,10 @@
 #include "uart1_defs.h"
 
 
+/* Non-zero if the clock reference is held.  */
+static bool uart1_active;
+
+
 void
 uart1_baud_divisor_set (uint16_t baud_divisor)
 {
@@ -27,8 +31,13 @@ uart1_init (uint16_t baud_divisor)
     pio_config_set (URXD1_PIO, URXD1_PERIPH);
     pio_config_set (UTXD1_PIO, UTXD1_PERIPH);
 
-    /* Enable UART1 clock.  */
-    mcu_pmc_enable (ID_UART1);
+    /* Enable UART1 clock.  Only take a reference on the first call so
+       that the baud rate can be changed by calling this again.  */
+    if (! uart1_active)
+    {
+        mcu_pmc_acquire (ID_UART1);
+        uart1_active = 1;
+    }
     
     /* Reset and disable receiver and transmitter.  */
     UART1->UART_CR = UART_CR_RSTRX | UART_CR_RSTTX          
@@ -54,7 +63,11 @@ uart1_shutdown (void)
     pio_config_set (UTXD1_PIO, PIO_OUTPUT_LOW);
 
     /* Disable UART1 clock.  */
-    mcu_pmc_disable (ID_UART1);
+    if (uart1_active)
+    {
+        mcu_pmc_release (ID_UART1);
+        uart1_active = 0;
+    }
     
     /* Reset and disable receiver and transmitter.  */
     UART1->UART_CR = UART_CR_RSTRX | UART_CR_RSTTX          
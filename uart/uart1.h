@@ -39,6 +39,10 @@ uart1_write_finished_p (void);
 int
 uart1_putc (char ch);
 
+/* Set baud rate divisor.  */
+void
+uart1_baud_divisor_set (uint16_t baud_divisor);
+
 /* Initialise UART1 and set baud rate.  */
 int
 uart1_init (uint16_t baud_divisor);
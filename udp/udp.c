@@ -493,6 +493,7 @@ static void udp_endpoint_handler (udp_t udp, udp_ep_t endpoint);
 
 /* UDP interrupt service routine.  Handle all UDP peripheral
    interrupts.  */
+__ramfunc_if__ (MAT91LIB_RAMFUNC_ISR)
 static void
 udp_interrupt_handler (void)
 {
@@ -538,7 +539,7 @@ udp_interrupt_handler (void)
                 // Disable transceiver
                 UDP->UDP_TXVC |= UDP_TXVC_TXVDIS;
                 // Disable peripheral clock
-                mcu_pmc_disable (ID_UDP);
+                mcu_pmc_release (ID_UDP);
                 // Disable UDPCK
                 PMC->PMC_SCDR |= PMC_SCDR_UDP;
 
@@ -553,7 +554,7 @@ udp_interrupt_handler (void)
             // TRACE_INFO (UDP, "UDP:Resm\n");
 
             // Enable master clock
-            mcu_pmc_enable (ID_UDP);
+            mcu_pmc_acquire (ID_UDP);
             // Enable peripheral clock for UDP
             PMC->PMC_SCER |= PMC_SCER_UDP;
 
@@ -773,6 +774,7 @@ udp_rx_flag_clear (udp_t udp, udp_ep_t endpoint)
  * \param   endpoint    Endpoint to write data
  *
  */
+__ramfunc_if__ (MAT91LIB_RAMFUNC_LOOP)
 void
 udp_endpoint_fifo_write (udp_t udp, udp_ep_t endpoint)
 {
@@ -1567,7 +1569,7 @@ udp_enable (udp_t udp)
 
     // Enable the 48MHz USB clock UDPCK and System Peripheral USB clock
     PMC->PMC_SCER |= PMC_SCER_UDP;
-    mcu_pmc_enable (ID_UDP);
+    mcu_pmc_acquire (ID_UDP);
 
     for (i = 0; i < UDP_EP_NUM; i++)
         udp->eps[i].bank = 0;
@@ -1586,7 +1588,7 @@ udp_disable (udp_t udp)
 
     // Disable the 48MHz USB clock UDPCK and System Peripheral USB Clock
     PMC->PMC_SCDR |= PMC_SCDR_UDP;
-    mcu_pmc_disable (ID_UDP);
+    mcu_pmc_release (ID_UDP);
 
     // Disable the interrupt on the interrupt controller
     irq_disable (ID_UDP);
@@ -1707,15 +1709,23 @@ udp_bus_reset_handler (udp_t udp)
 
 
 #ifdef USB_VBUS_PIO
+#ifdef __SAM4S__
+/* This is called by the PIO port dispatcher, which reads PIO_ISR on
+   behalf of all the handlers for the port.  */
+static void
+udp_vbus_interrupt_handler (void *arg, pio_t pio)
+{
+    udp_t udp = arg;
+#else
 static void
 udp_vbus_interrupt_handler (void)
 {
     udp_t udp = &udp_dev;
 
     /* FIXME.  Reading PIO_ISR automatically clears all PIO
-       interrupts.  pio.c needs modifying to register separate PIO
-       interrupt handlers. */
+       interrupts.  */
     pio_irq_clear (USB_VBUS_PIO);
+#endif
 
     if (pio_input_get (USB_VBUS_PIO) != 0)
         udp_attach (udp);
@@ -1746,9 +1756,13 @@ udp_t udp_init (udp_request_handler_t request_handler, void *arg)
 
     pio_irq_config_set (USB_VBUS_PIO, PIO_IRQ_ANY_EDGE);
 
+#ifdef __SAM4S__
+    pio_irq_handler_set (USB_VBUS_PIO, 1, udp_vbus_interrupt_handler, udp);
+#else
     irq_config (PIO_ID (USB_VBUS_PIO), 1, udp_vbus_interrupt_handler);
 
     irq_enable (PIO_ID (USB_VBUS_PIO));
+#endif
 
     pio_irq_enable (USB_VBUS_PIO);
 
@@ -1761,5 +1775,7 @@ udp_t udp_init (udp_request_handler_t request_handler, void *arg)
     udp_attach (udp);
 #endif
 
+    BOOT_PROFILE_MARK ("udp_init");
+
     return udp;
 }
@@ -60,6 +60,7 @@ busart0_tx_finished_p (void)
 }
 
 
+__ramfunc_if__ (MAT91LIB_RAMFUNC_ISR)
 static void
 busart0_isr (void)
 {
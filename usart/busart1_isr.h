@@ -62,6 +62,7 @@ busart1_tx_finished_p (void)
 }
 
 
+__ramfunc_if__ (MAT91LIB_RAMFUNC_ISR)
 static void
 busart1_isr (void)
 {
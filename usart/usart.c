@@ -23,9 +23,15 @@
    can be enabled by defining USART0_USE_HANDSHAKING or
    USART1_USE_HANDSHAKING in target.h  */
 
+#include <errno.h>
 #include "usart.h"
 #include "sys.h"
 #include "peripherals.h"
+#include "mcu.h"
+#ifdef __SAM4S__
+#include "pdc.h"
+#include "irq.h"
+#endif
 
 #ifndef USART0_ENABLE
 #define USART0_ENABLE (USART_NUM >= 1)
@@ -35,6 +41,15 @@
 #define USART1_ENABLE (USART_NUM >= 2)
 #endif
 
+#ifndef USART_CLOCK_CHANGE_POLLS
+#define USART_CLOCK_CHANGE_POLLS 100000
+#endif
+
+/* Interrupt priority for asynchronous I/O completion.  */
+#ifndef USART_IRQ_PRIORITY
+#define USART_IRQ_PRIORITY 5
+#endif
+
 
 struct usart_dev_struct
 {
@@ -43,18 +58,40 @@ struct usart_dev_struct
     bool (*read_ready_p) (void);
     bool (*write_ready_p) (void);
     bool (*write_finished_p) (void);
+    void (*baud_divisor_set) (uint16_t baud_divisor);
     uint32_t read_timeout_us;
     uint32_t write_timeout_us;
+    /* Zero if the baud divisor was specified.  */
+    uint32_t baud_rate;
+#ifdef __SAM4S__
+    /* The following are for asynchronous I/O using the PDC.  */
+    Usart *base;
+    Pdc *pdc_base;
+    irq_id_t irq_id;
+    irq_handler_t aio_isr;
+    pdc_t pdc;
+    pdc_descriptor_t rx_descriptor;
+    pdc_descriptor_t tx_descriptor;
+    sys_aio_t * volatile aread;
+    sys_aio_t * volatile awrite;
+#endif
 };
 
 
+#ifdef __SAM4S__
+static void usart0_aio_isr (void);
+static void usart1_aio_isr (void);
+#endif
+
+
 /* Include machine dependent usart definitions.  */
 #if USART0_ENABLE
 #include "usart0.h"
 
 static usart_dev_t usart0_dev = {usart0_putc, usart0_getc,
                                  usart0_read_ready_p, usart0_write_ready_p,
-                                 usart0_write_finished_p, 0, 0};
+                                 usart0_write_finished_p,
+                                 usart0_baud_divisor_set, 0, 0, 0};
 #endif
 
 #if USART1_ENABLE
@@ -62,10 +99,36 @@ static usart_dev_t usart0_dev = {usart0_putc, usart0_getc,
 
 static usart_dev_t usart1_dev = {usart1_putc, usart1_getc,
                                  usart1_read_ready_p, usart1_write_ready_p,
-                                 usart1_write_finished_p, 0, 0};
+                                 usart1_write_finished_p,
+                                 usart1_baud_divisor_set, 0, 0, 0};
 #endif
 
 
+/* Recompute the baud rate divisor when MCK changes.  */
+static void
+usart_clock_notify (void *arg, mcu_clock_event_t event, uint32_t f_mck)
+{
+    usart_dev_t *dev = arg;
+    unsigned int i;
+
+    if (!dev->baud_rate)
+        return;
+
+    if (event == MCU_CLOCK_CHANGE_PRE)
+    {
+        /* Let the character being sent finish at the old baud rate.
+           The number of polls is limited in case the transmitter is
+           stalled by flow control.  */
+        for (i = 0; i < USART_CLOCK_CHANGE_POLLS
+                 && !dev->write_finished_p (); i++)
+            continue;
+        return;
+    }
+
+    dev->baud_divisor_set ((f_mck / 16) / dev->baud_rate);
+}
+
+
 usart_t 
 usart_init (const usart_cfg_t *cfg)
 {
@@ -75,13 +138,19 @@ usart_init (const usart_cfg_t *cfg)
     if (cfg->baud_rate == 0)
         baud_divisor = cfg->baud_divisor;
     else
-        baud_divisor = USART_BAUD_DIVISOR (cfg->baud_rate);
+        baud_divisor = (mcu_clock_get () / 16) / cfg->baud_rate;
 
 #if USART0_ENABLE
     if (cfg->channel == 0)
     {
         usart0_init (baud_divisor);
         dev = &usart0_dev;
+#ifdef __SAM4S__
+        dev->base = USART0;
+        dev->pdc_base = PDC_USART0;
+        dev->irq_id = ID_USART0;
+        dev->aio_isr = usart0_aio_isr;
+#endif
     }
 #endif
 
@@ -90,11 +159,21 @@ usart_init (const usart_cfg_t *cfg)
     {
         usart1_init (baud_divisor);
         dev = &usart1_dev;
+#ifdef __SAM4S__
+        dev->base = USART1;
+        dev->pdc_base = PDC_USART1;
+        dev->irq_id = ID_USART1;
+        dev->aio_isr = usart1_aio_isr;
+#endif
     }
 #endif
 
     dev->read_timeout_us = cfg->read_timeout_us;
     dev->write_timeout_us = cfg->write_timeout_us;
+    dev->baud_rate = cfg->baud_rate;
+
+    if (!mcu_clock_notify_register (usart_clock_notify, dev))
+        return 0;
     return dev;
 }
 
@@ -129,6 +208,31 @@ usart_write_finished_p (usart_t usart)
 }
 
 
+/* Enable the peripheral interrupt for MASK so that the device
+   becoming ready wakes the core.  Unless asynchronous I/O has enabled
+   the interrupt in the NVIC, the pending interrupt is cleared before
+   the device is checked; see MCU_WAIT_UNTIL.  Otherwise the interrupt
+   handler disables the interrupt for MASK when it is taken.  */
+static void
+usart_wake_arm (usart_dev_t *dev, uint32_t mask)
+{
+#if MCU_IDLE_WAIT
+    dev->base->US_IER = mask;
+    if (!dev->pdc)
+        irq_clear (dev->irq_id);
+#endif
+}
+
+
+static void
+usart_wake_disarm (usart_dev_t *dev, uint32_t mask)
+{
+#if MCU_IDLE_WAIT
+    dev->base->US_IDR = mask;
+#endif
+}
+
+
 /** Read size bytes.  */
 static int16_t
 usart_read_nonblock (usart_t usart, void *data, uint16_t size)
@@ -179,15 +283,34 @@ usart_write_nonblock (usart_t usart, const void *data, uint16_t size)
 }
 
 
+static int16_t
+usart_read_wake (usart_t usart, void *data, uint16_t size)
+{
+    usart_wake_arm (usart, US_IER_RXRDY);
+    return usart_read_nonblock (usart, data, size);
+}
+
+
+static int16_t
+usart_write_wake (usart_t usart, const void *data, uint16_t size)
+{
+    usart_wake_arm (usart, US_IER_TXRDY);
+    return usart_write_nonblock (usart, data, size);
+}
+
+
 /** Read size bytes.  Block until all the bytes have been read or
     until timeout occurs.  */
 ssize_t
 usart_read (void *usart, void *data, size_t size)
 {
     usart_dev_t *dev = usart;
-    
-    return sys_read_timeout (usart, data, size, dev->read_timeout_us,
-                             (void *)usart_read_nonblock);
+    ssize_t ret;
+
+    ret = sys_read_timeout_wake (usart, data, size, dev->read_timeout_us,
+                                 (void *)usart_read_wake);
+    usart_wake_disarm (dev, US_IDR_RXRDY);
+    return ret;
 }
 
 
@@ -197,9 +320,12 @@ ssize_t
 usart_write (void *usart, const void *data, size_t size)
 {
     usart_dev_t *dev = usart;
-    
-    return sys_write_timeout (usart, data, size, dev->write_timeout_us,
-                              (void *)usart_write_nonblock);
+    ssize_t ret;
+
+    ret = sys_write_timeout_wake (usart, data, size, dev->write_timeout_us,
+                                  (void *)usart_write_wake);
+    usart_wake_disarm (dev, US_IDR_TXRDY);
+    return ret;
 }
 
 
@@ -247,8 +373,163 @@ usart_puts (usart_t usart, const char *str)
 }
 
 
+#ifdef __SAM4S__
+/* The ENDRX and ENDTX flags are set when the PDC receive and transmit
+   counters reach zero.  Since only a single buffer is used for each
+   request, the next counters are left at zero.  */
+static void
+usart_aio_isr (usart_dev_t *dev)
+{
+    uint32_t status;
+    sys_aio_t *aio;
+
+    status = dev->base->US_CSR & dev->base->US_IMR;
+
+    /* These are enabled by a blocking read or write to wake the core.
+       They are disabled so that the interrupt does not repeat and are
+       enabled again before the device is next polled.  */
+    if (status & (US_CSR_RXRDY | US_CSR_TXRDY))
+        dev->base->US_IDR = status & (US_IDR_RXRDY | US_IDR_TXRDY);
+
+    if (status & US_CSR_ENDRX)
+    {
+        dev->base->US_IDR = US_IDR_ENDRX;
+        pdc_read_disable (dev->pdc);
+        aio = dev->aread;
+        dev->aread = 0;
+        if (aio)
+            sys_aio_complete (aio, aio->size, 0);
+    }
+
+    if (status & US_CSR_ENDTX)
+    {
+        dev->base->US_IDR = US_IDR_ENDTX;
+        pdc_write_disable (dev->pdc);
+        aio = dev->awrite;
+        dev->awrite = 0;
+        if (aio)
+            sys_aio_complete (aio, aio->size, 0);
+    }
+}
+
+
+static void
+usart0_aio_isr (void)
+{
+#if USART0_ENABLE
+    usart_aio_isr (&usart0_dev);
+#endif
+}
+
+
+static void
+usart1_aio_isr (void)
+{
+#if USART1_ENABLE
+    usart_aio_isr (&usart1_dev);
+#endif
+}
+
+
+/* The PDC and interrupt are only set up on the first asynchronous
+   request so that the blocking I/O is unaffected otherwise.  */
+static bool
+usart_aio_setup (usart_dev_t *dev, sys_aio_t *aio)
+{
+    if (aio->size > UINT16_MAX)
+    {
+        errno = EINVAL;
+        return 0;
+    }
+
+    if (!dev->pdc)
+    {
+        dev->pdc = pdc_init (dev->pdc_base, 0, 0);
+        if (!dev->pdc)
+        {
+            errno = ENOMEM;
+            return 0;
+        }
+        irq_config (dev->irq_id, USART_IRQ_PRIORITY, dev->aio_isr);
+        irq_enable (dev->irq_id);
+    }
+    return 1;
+}
+
+
+static int
+usart_aread (void *usart, sys_aio_t *aio)
+{
+    usart_dev_t *dev = usart;
+
+    if (dev->aread)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (!usart_aio_setup (dev, aio))
+        return -1;
+
+    dev->aread = aio;
+    dev->rx_descriptor.buffer = aio->buffer;
+    dev->rx_descriptor.size = aio->size;
+    dev->rx_descriptor.next = 0;
+
+    pdc_read_config (dev->pdc, &dev->rx_descriptor);
+    pdc_read_enable (dev->pdc);
+    dev->base->US_IER = US_IER_ENDRX;
+    return 0;
+}
+
+
+static int
+usart_awrite (void *usart, sys_aio_t *aio)
+{
+    usart_dev_t *dev = usart;
+
+    if (dev->awrite)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (!usart_aio_setup (dev, aio))
+        return -1;
+
+    dev->awrite = aio;
+    dev->tx_descriptor.buffer = aio->buffer;
+    dev->tx_descriptor.size = aio->size;
+    dev->tx_descriptor.next = 0;
+
+    pdc_write_config (dev->pdc, &dev->tx_descriptor);
+    pdc_write_enable (dev->pdc);
+    dev->base->US_IER = US_IER_ENDTX;
+    return 0;
+}
+#endif
+
+
+static int
+usart_poll (void *usart, int events)
+{
+    int revents = 0;
+
+    if ((events & SYS_POLL_IN) && usart_read_ready_p (usart))
+        revents |= SYS_POLL_IN;
+    if ((events & SYS_POLL_OUT) && usart_write_ready_p (usart))
+        revents |= SYS_POLL_OUT;
+    return revents;
+}
+
+
 const sys_file_ops_t usart_file_ops =
 {
     .read = (void *)usart_read,
-    .write = (void *)usart_write
+    .write = (void *)usart_write,
+    .poll = usart_poll,
+#ifdef __SAM4S__
+    .aread = usart_aread,
+    .awrite = usart_awrite
+#endif
 };
@@ -4,3 +4,8 @@ VPATH += $(USART_DIR)
 INCLUDES += -I$(USART_DIR)
 
 SRC += usart.c usart0.c usart1.c
+
+# The PDC is used for asynchronous I/O on the SAM4S.
+ifeq ($(FAMILY), sam4s)
+include $(MAT91LIB_DIR)/pdc/pdc.mk
+endif
@@ -9,6 +9,10 @@
 #include "usart0.h"
 #include "usart0_defs.h"
 
+
+/* Non-zero if the clock reference is held.  */
+static bool usart0_active;
+
 /* Temporary hack.  */
 #undef USART0_USE_HANDSHAKING
 
@@ -43,8 +47,13 @@ usart0_init (uint16_t baud_divisor)
     pio_config_set (CTS0_PIO, CTS0_PERIPH);
 #endif
 
-    /* Enable USART0 clock.  */
-    mcu_pmc_enable (ID_USART0);
+    /* Enable USART0 clock.  Only take a reference on the first call so
+       that the baud rate can be changed by calling this again.  */
+    if (! usart0_active)
+    {
+        mcu_pmc_acquire (ID_USART0);
+        usart0_active = 1;
+    }
 
     /* Reset and disable receiver and transmitter.  */
     USART0->US_CR = US_CR_RSTRX | US_CR_RSTTX
@@ -74,7 +83,11 @@ usart0_shutdown (void)
     pio_config_set (RXD0_PIO, PIO_OUTPUT_LOW);
 
     /* Disable USART0 clock.  */
-    mcu_pmc_disable (ID_USART0);
+    if (usart0_active)
+    {
+        mcu_pmc_release (ID_USART0);
+        usart0_active = 0;
+    }
 
     /* Reset and disable receiver and transmitter.  */
     USART0->US_CR = US_CR_RSTRX | US_CR_RSTTX
@@ -37,6 +37,10 @@ usart0_write_finished_p (void);
 int
 usart0_putc (char ch);
 
+/* Set baud rate divisor.  */
+void
+usart0_baud_divisor_set (uint16_t baud_divisor);
+
 /* Initialise USART0 and set baud rate.  */
 int
 usart0_init (uint16_t baud_divisor);
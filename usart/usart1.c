@@ -9,6 +9,10 @@
 #include "usart1.h"
 #include "usart1_defs.h"
 
+
+/* Non-zero if the clock reference is held.  */
+static bool usart1_active;
+
 /* Temporary hack.  */
 #undef USART1_USE_HANDSHAKING
 
@@ -43,8 +47,13 @@ usart1_init (uint16_t baud_divisor)
     pio_config_set (CTS1_PIO, CTS1_PERIPH);
 #endif
     
-    /* Enable USART1 clock.  */
-    mcu_pmc_enable (ID_USART1);
+    /* Enable USART1 clock.  Only take a reference on the first call so
+       that the baud rate can be changed by calling this again.  */
+    if (! usart1_active)
+    {
+        mcu_pmc_acquire (ID_USART1);
+        usart1_active = 1;
+    }
     
     /* Reset and disable receiver and transmitter.  */
     USART1->US_CR = US_CR_RSTRX | US_CR_RSTTX          
@@ -71,7 +80,11 @@ usart1_shutdown (void)
     pio_config_set (TXD1_PIO, PIO_OUTPUT_LOW);
 
     /* Disable USART1 clock.  */
-    mcu_pmc_disable (ID_USART1);
+    if (usart1_active)
+    {
+        mcu_pmc_release (ID_USART1);
+        usart1_active = 0;
+    }
     
     /* Reset and disable receiver and transmitter.  */
     USART1->US_CR = US_CR_RSTRX | US_CR_RSTTX          
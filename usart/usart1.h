@@ -39,6 +39,10 @@ usart1_write_finished_p (void);
 int
 usart1_putc (char ch);
 
+/* Set baud rate divisor.  */
+void
+usart1_baud_divisor_set (uint16_t baud_divisor);
+
 /* Initialise USART1 and set baud rate.  */
 int
 usart1_init (uint16_t baud_divisor);